@@ -14,6 +14,9 @@ using namespace llvm;
 
 #include <llvm/Support/raw_ostream.h>
 
+#include <unordered_map>
+#include <vector>
+
 const bool DEBUG = false;
 
 Function *getGCFunction(Module *m) {
@@ -42,24 +45,27 @@ unsigned getGCFunctionIndex(FunctionsInfoMapTy& functionsMap, Module *m) {
 // returning a fresh pointer at all or under certain conditions.  But, all
 // functions possibly returning a fresh pointer should be identified.
 
-void findPossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned) {
+static void computePossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned) {
 
   if (f->getReturnType()->isVoidTy()) {
     return;
   }
   if (DEBUG) errs() << "Function " << funName(f) << "...\n";
   
+  std::vector<AllocaInst*> workList;
+  
   // insert variables values of which are directly returned
-  for(inst_iterator ini = inst_begin(*f), ine = inst_end(*f); ini != ine; ++ini) {
-    Instruction *in = &*ini;
-    if (ReturnInst::classof(in)) {
-      Value* returnOperand = cast<ReturnInst>(in)->getReturnValue();
-
-      ValuesSetTy vorig = valueOrigins(returnOperand); 
-      for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
-        Value *v = *vi;
-        if (AllocaInst* var = dyn_cast<AllocaInst>(v)) {
-          possiblyReturned.insert(var);
+  for(Function::iterator bb = f->begin(), bbe = f->end(); bb != bbe; ++bb) {
+    ReturnInst *ret = dyn_cast<ReturnInst>(bb->getTerminator());
+    if (!ret) {
+      continue;
+    }
+    ValuesSetTy vorig = valueOrigins(ret->getReturnValue()); 
+    for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
+      Value *v = *vi;
+      if (AllocaInst* var = dyn_cast<AllocaInst>(v)) {
+        if (possiblyReturned.insert(var).second) {
+          workList.push_back(var);
           if (DEBUG) errs() << "  directly returned " << varName(var) << "(" << *var << ")\n";
         }
       }
@@ -68,31 +74,24 @@ void findPossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned) {
   
   // insert variables values of which may be stored into possibly returned
   // variables
+  //   each variable is visited once, following the stores into it (def-use chains)
   
-  bool addedVar = true;
-  while (addedVar) {
-    addedVar = false;
+  while(!workList.empty()) {
+    AllocaInst *dst = workList.back();
+    workList.pop_back();
     
-    for(inst_iterator ini = inst_begin(*f), ine = inst_end(*f); ini != ine; ++ini) {
-      Instruction *in = &*ini;
-      if (StoreInst::classof(in)) {
-        Value *storePointerOperand = cast<StoreInst>(in)->getPointerOperand();
-        if (!AllocaInst::classof(storePointerOperand)) continue;
-        
-        AllocaInst* dst = cast<AllocaInst>(storePointerOperand);
-        if (possiblyReturned.find(dst) == possiblyReturned.end()) {
-          continue;
-        }
-        
-        ValuesSetTy vorig = valueOrigins(cast<StoreInst>(in)->getValueOperand());
-        for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
-          Value *v = *vi;
-          if (AllocaInst* src = dyn_cast<AllocaInst>(v)) {
-            if (possiblyReturned.find(src) == possiblyReturned.end()) {
-              possiblyReturned.insert(src);
-              addedVar = true;
-              if (DEBUG) errs() << "  indirectly returned " << varName(src) << " through " << varName(dst) << " store " << *in << "\n";
-            }
+    for(Value::user_iterator ui = dst->user_begin(), ue = dst->user_end(); ui != ue; ++ui) {
+      StoreInst *st = dyn_cast<StoreInst>(*ui);
+      if (!st || st->getPointerOperand() != dst) {
+        continue;
+      }
+      ValuesSetTy vorig = valueOrigins(st->getValueOperand());
+      for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
+        Value *v = *vi;
+        if (AllocaInst* src = dyn_cast<AllocaInst>(v)) {
+          if (possiblyReturned.insert(src).second) {
+            workList.push_back(src);
+            if (DEBUG) errs() << "  indirectly returned " << varName(src) << " through " << varName(dst) << " store " << *st << "\n";
           }
         }
       }
@@ -100,8 +99,24 @@ void findPossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned) {
   }
 }
 
+// the result is computed once per function and kept in possiblyReturnedVars,
+//   which the called module shares between the allocator detection and
+//   the context-sensitive allocator detection
+
+const VarsSetTy& findPossiblyReturnedVariables(Function *f, PossiblyReturnedVarsMapTy& possiblyReturnedVars) {
+
+  auto csearch = possiblyReturnedVars.find(f);
+  if (csearch != possiblyReturnedVars.end()) {
+    return csearch->second;
+  }
+  
+  VarsSetTy& possiblyReturned = possiblyReturnedVars.insert({f, VarsSetTy()}).first->second;
+  computePossiblyReturnedVariables(f, possiblyReturned);
+  return possiblyReturned;
+}
+
 // this ignores derived/cast values
-static bool valueMayBeReturned(Value* v, VarsSetTy& possiblyReturned) {
+static bool valueMayBeReturned(Value* v, const VarsSetTy& possiblyReturned) {
 
   for(Value::user_iterator ui = v->user_begin(), ue = v->user_end(); ui != ue; ++ui) {
     User *u = *ui;
@@ -137,11 +152,10 @@ static bool valueMayBeReturned(Value* v, VarsSetTy& possiblyReturned) {
 //
 // returns an empty set if this function cannot be an allocator
 
-void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Function* gcFunction) {
+void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Function* gcFunction, PossiblyReturnedVarsMapTy& possiblyReturnedVars) {
   if (!isSEXP(f->getReturnType())) return; // allocator must return SEXP
 
-  VarsSetTy possiblyReturnedVars;
-  findPossiblyReturnedVariables(f, possiblyReturnedVars);
+  const VarsSetTy& possiblyReturned = findPossiblyReturnedVariables(f, possiblyReturnedVars);
       
   for(Function::iterator bb = f->begin(), bbe = f->end(); bb != bbe; ++bb) {
     for(BasicBlock::iterator in = bb->begin(), ine = bb->end(); in != ine; ++in) {
@@ -156,7 +170,7 @@ void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Functi
         wrappedAllocators.insert(tgt);
         continue;
       }
-      if (isCallThroughPointer(v) && valueMayBeReturned(v, possiblyReturnedVars)) {
+      if (isCallThroughPointer(v) && valueMayBeReturned(v, possiblyReturned)) {
         if (DEBUG) errs() << "SEXP function " << funName(f) << " calls through a pointer, asserted to call gc function\n";
         wrappedAllocators.insert(gcFunction);
         continue;
@@ -166,7 +180,7 @@ void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Functi
       if (isKnownNonAllocator(tgt)) continue;
         
       // tgt is a function returning an SEXP, check if the result may be returned by function f
-      if (valueMayBeReturned(v, possiblyReturnedVars)) {
+      if (valueMayBeReturned(v, possiblyReturned)) {
         if (DEBUG) errs() << "SEXP function " << funName(f) << " wraps functions " << funName(tgt) << "\n";
         wrappedAllocators.insert(tgt);
       }
@@ -175,6 +189,11 @@ void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Functi
 }
 
 void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators) {
+  PossiblyReturnedVarsMapTy possiblyReturnedVars;
+  findPossibleAllocators(m, possibleAllocators, possiblyReturnedVars);
+}
+
+void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators, PossiblyReturnedVarsMapTy& possiblyReturnedVars) {
 
   FunctionsSetTy onlyFunctions;
   CallEdgesMapTy onlyEdges;
@@ -188,7 +207,7 @@ void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators) {
       continue;
     }
     FunctionsSetTy wrappedAllocators;
-    getWrappedAllocators(f, wrappedAllocators, gcFunction);
+    getWrappedAllocators(f, wrappedAllocators, gcFunction, possiblyReturnedVars);
     if (!wrappedAllocators.empty()) {
       onlyEdges.insert({f, new FunctionsSetTy(wrappedAllocators)});
       onlyFunctions.insert(f);
@@ -21,14 +21,17 @@ const std::string gcFunction = "R_gc_internal";
 Function *getGCFunction(Module *m);
 unsigned getGCFunctionIndex(FunctionsInfoMapTy& functionsMap, Module *m);
 
+typedef std::unordered_map<Function*, VarsSetTy> PossiblyReturnedVarsMapTy; // for functions of one module
+
 bool mayBeAllocator(Function& f);
 void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators);
+void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators, PossiblyReturnedVarsMapTy& possiblyReturnedVars); // fills in possiblyReturnedVars
 
 bool isAllocatingFunction(Function *fun, FunctionsInfoMapTy& functionsMap, unsigned gcFunctionIndex);
 void findAllocatingFunctions(Module *m, FunctionsSetTy& allocatingFunctions);
 
-void findPossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned);
-void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Function* gcFunction);
+const VarsSetTy& findPossiblyReturnedVariables(Function *f, PossiblyReturnedVarsMapTy& possiblyReturnedVars); // computed once per function
+void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Function* gcFunction, PossiblyReturnedVarsMapTy& possiblyReturnedVars);
 
 bool isKnownNonAllocator(Function *f);
 
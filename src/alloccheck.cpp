@@ -36,7 +36,7 @@ int main(int argc, char* argv[])
   const CalledFunctionsIndexTy* calledFunctions = cm->getCalledFunctions();
 
   outs() << "Callee protect functions: \n";
-  CProtectInfo cprotect = findCalleeProtectFunctions(m, *cm->getContextSensitiveAllocatingFunctions());
+  CProtectInfo cprotect = findCalleeProtectFunctions(m, *cm->getContextSensitiveAllocatingFunctions(), cm->getFunctionIds());
   for(FunctionsVectorTy::iterator fi = functionsOfInterestVector.begin(), fe = functionsOfInterestVector.end(); fi != fe; ++fi) {
     Function *fun = *fi;
     if (cprotect.isCalleeProtect(fun, true /* non-trivially */)) {
@@ -63,9 +63,7 @@ int main(int argc, char* argv[])
     if (!cprotect.isNonTrivial(fun)) {
       continue;
     }
-    auto fsearch = cprotect.map.find(fun);
-    myassert(fsearch != cprotect.map.end());
-    CPArgsTy& cpargs = fsearch->second;
+    const CPArgsTy& cpargs = cprotect.getArgs(fun);
   
     unsigned nargs = cpargs.size();
     
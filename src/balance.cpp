@@ -25,15 +25,11 @@ using namespace llvm;
 //   - which can be assigned to R_PPStackTop (typically at end of function)
 //   - it must have at least one load/store of R_PPStackTop
 
-bool isProtectionStackTopSaveVariable(AllocaInst* var, GlobalVariable* ppStackTopVariable, VarBoolCacheTy& cache) {
+bool isProtectionStackTopSaveVariable(AllocaInst* var, GlobalVariable* ppStackTopVariable) {
 
   if (!ppStackTopVariable) {
     return false;
   }
-  auto csearch = cache.find(var);
-  if (csearch != cache.end()) {
-    return csearch->second;
-  }
   
   bool usesPPStackTop = false;
   for(Value::user_iterator ui = var->user_begin(), ue = var->user_end(); ui != ue; ++ui) {
@@ -59,10 +55,8 @@ bool isProtectionStackTopSaveVariable(AllocaInst* var, GlobalVariable* ppStackTo
       continue; // can also do something else with "var" value
     }
     // some other use
-    cache.insert({var, false});
     return false;
   }
-  cache.insert({var, usesPPStackTop});
   return usesPPStackTop;
 }
 
@@ -147,23 +141,7 @@ bool isProtectionCounterVariable(AllocaInst* var, Function* unprotectFunction) {
   return passedToUnprotect;
 }
 
-bool isProtectionCounterVariable(AllocaInst* var, Function* unprotectFunction, VarBoolCacheTy& cache) {
-
-  if (!unprotectFunction) {
-    return false;
-  }
-  auto csearch = cache.find(var);
-  if (csearch != cache.end()) {
-    return csearch->second;
-  }
-
-  bool res = isProtectionCounterVariable(var, unprotectFunction);
-  
-  cache.insert({var, res});
-  return res;
-}
-
-static void handleCall(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& counterVarsCache, LineMessenger& msg, unsigned& refinableInfos) {
+static void handleCall(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarTableTy& vars, LineMessenger& msg, unsigned& refinableInfos) {
   
   CallSite cs(cast<Value>(in));
   if (!cs) {
@@ -235,7 +213,7 @@ static void handleCall(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBool
       Value *varValue = const_cast<Value*>(cast<LoadInst>(npvar)->getPointerOperand());
       if (AllocaInst::classof(varValue)) {
         AllocaInst* var = cast<AllocaInst>(varValue);
-        if (!isProtectionCounterVariable(var, g.unprotectFunction, counterVarsCache)) {
+        if (!vars.isProtectionCounter(var)) {
           msg.info(MSG_PFX + "has an unsupported form of unprotect with a variable " + CONFUSION_DISCLAIMER, in);
           if (QUIET_WHEN_CONFUSED) {
             b.confused = true;
@@ -298,7 +276,7 @@ static void handleCall(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBool
   }
 }
 
-static void handleLoad(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& saveVarsCache, LineMessenger& msg, unsigned& refinableInfos) {
+static void handleLoad(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarTableTy& vars, LineMessenger& msg, unsigned& refinableInfos) {
 
   if (!LoadInst::classof(in)) {
     return;
@@ -311,7 +289,7 @@ static void handleLoad(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBool
         StoreInst* topStoreInst = cast<StoreInst>(user);
         if (AllocaInst::classof(topStoreInst->getPointerOperand())) {
           AllocaInst* topStore = cast<AllocaInst>(topStoreInst->getPointerOperand());
-          if (isProtectionStackTopSaveVariable(topStore, g.ppStackTopVariable, saveVarsCache)) {
+          if (vars.isProtectionStackTopSave(topStore)) {
             // topStore is the alloca instruction for the local variable where R_PPStack is saved to
             // e.g. %save = alloca i32, align 4
             if (b.countState == CS_DIFF) {
@@ -333,7 +311,7 @@ static void handleLoad(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBool
   }
 }
 
-static void handleStore(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& saveVarsCache, VarBoolCacheTy& counterVarsCache,
+static void handleStore(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarTableTy& vars,
     LineMessenger& msg, unsigned& refinableInfos) {
     
   if (!StoreInst::classof(in)) {
@@ -375,7 +353,7 @@ static void handleStore(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoo
     return;  
   }
   if (AllocaInst::classof(storePointerOp) && 
-    isProtectionCounterVariable(cast<AllocaInst>(storePointerOp), g.unprotectFunction, counterVarsCache)) { // nprotect = ... 
+    vars.isProtectionCounter(cast<AllocaInst>(storePointerOp))) { // nprotect = ... 
               
     AllocaInst* storePointerVar = cast<AllocaInst>(storePointerOp);
     if (!b.counterVar) {
@@ -460,7 +438,7 @@ static void handleStore(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoo
   }  
 }
 
-void handleBalanceForNonTerminator(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& counterVarsCache, VarBoolCacheTy& saveVarsCache,
+void handleBalanceForNonTerminator(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarTableTy& vars,
     LineMessenger& msg, unsigned& refinableInfos) {
 
   if (b.countState != CS_DIFF && b.depth < 0) {
@@ -470,28 +448,28 @@ void handleBalanceForNonTerminator(Instruction *in, BalanceStateTy& b, GlobalsTy
   }
 
   if (!QUIET_WHEN_CONFUSED || !b.confused) {
-    handleCall(in, b, g, counterVarsCache, msg, refinableInfos);
+    handleCall(in, b, g, vars, msg, refinableInfos);
   } else {
     if (msg.trace()) msg.trace(MSG_PFX + "not handling instruction as (already) confused", in);
     return;
   }
 
   if (!QUIET_WHEN_CONFUSED || !b.confused) {
-    handleLoad(in, b, g, saveVarsCache, msg, refinableInfos);
+    handleLoad(in, b, g, vars, msg, refinableInfos);
   } else {
     if (msg.trace()) msg.trace(MSG_PFX + "not handling instruction as (already) confused", in);
     return;
   }
 
   if (!QUIET_WHEN_CONFUSED || !b.confused) {
-    handleStore(in, b, g, saveVarsCache, counterVarsCache, msg, refinableInfos);
+    handleStore(in, b, g, vars, msg, refinableInfos);
   } else {
     if (msg.trace()) msg.trace(MSG_PFX + "not handling instruction as (already) confused", in);
     return;
   }
 }
 
-bool handleBalanceForTerminator(TerminatorInst* t, StateWithBalanceTy& s, GlobalsTy& g, VarBoolCacheTy& counterVarsCache, 
+bool handleBalanceForTerminator(TerminatorInst* t, StateWithBalanceTy& s, GlobalsTy& g, VarTableTy& vars, 
     LineMessenger& msg, unsigned& refinableInfos) {
 
   if (QUIET_WHEN_CONFUSED && s.balance.confused) {
@@ -539,7 +517,7 @@ bool handleBalanceForTerminator(TerminatorInst* t, StateWithBalanceTy& s, Global
   AllocaInst *var = cast<AllocaInst>(li->getPointerOperand());
 
   // if (nprotect) UNPROTECT(nprotect)
-  if (!isProtectionCounterVariable(var, g.unprotectFunction, counterVarsCache)) {
+  if (!vars.isProtectionCounter(var)) {
     return false;
   }
   if (!s.balance.counterVar) {
@@ -674,6 +652,34 @@ bool handleBalanceForTerminator(TerminatorInst* t, StateWithBalanceTy& s, Global
   return true;
 }
 
+void widenBalance(BalanceStateTy& b, LoopBalanceTy& seen, bool backEdge, LineMessenger& msg) {
+
+  if (QUIET_WHEN_CONFUSED && b.confused) {
+    return;
+  }
+  if (b.countState == CS_EXACT && seen.counts.insert(b.count).second && backEdge && ++seen.nLoopCounts > MAX_LOOP_COUNTS) {
+    // turn the counter to differential state, like for a large counter value
+    if (msg.debug()) msg.debug(MSG_PFX + "counter changes in a loop, switching to differential state", NULL);
+    b.countState = CS_DIFF;
+    b.depth -= b.count;
+    b.count = -1;
+  }
+
+  bool diff = b.countState == CS_DIFF;
+  bool grows = true; // higher than all depths seen in the same count state
+  for(std::set<std::pair<bool, int>>::const_iterator di = seen.depths.begin(), de = seen.depths.end(); di != de; ++di) {
+    if (di->first == diff && di->second >= b.depth) {
+      grows = false;
+    }
+  }
+  if (seen.depths.insert({diff, b.depth}).second && backEdge && ++seen.nLoopDepths > MAX_LOOP_DEPTHS && grows && b.depth <= MAX_DEPTH) {
+    // the depth would only stop growing at MAX_DEPTH, go there directly (the next protect reports it)
+    if (msg.debug()) msg.debug(MSG_PFX + "depth grows in a loop, skipping to the maximum depth", NULL);
+    b.depth = MAX_DEPTH + 1;
+    seen.depths.insert({diff, b.depth});
+  }
+}
+
 std::string cs_name(CountState cs) {
   switch(cs) {
     case CS_NONE: return "uninitialized (none)";
@@ -4,8 +4,10 @@
 #include "common.h"
 #include "linemsg.h"
 #include "state.h"
+#include "vartable.h"
 
 #include <map>
+#include <set>
 
 #include <llvm/IR/Instruction.h>
 
@@ -13,6 +15,8 @@ using namespace llvm;
 
 const int MAX_DEPTH = 64;	// maximum supported protection stack depth
 const int MAX_COUNT = 32;	// maximum supported protection counter value (before turning to differential)
+const unsigned MAX_LOOP_COUNTS = 4;	// maximum number of new exact counter values from back edges of a loop (before turning to differential)
+const unsigned MAX_LOOP_DEPTHS = 8;	// maximum number of new depths from back edges of a loop (before going to MAX_DEPTH)
 
 // protection counter (like "nprotect")
 enum CountState {
@@ -49,13 +53,34 @@ struct StateWithBalanceTy : virtual public StateBaseTy {
   void dump(bool verbose);  
 };
 
-bool isProtectionStackTopSaveVariable(AllocaInst* var, GlobalVariable* ppStackTopVariable, VarBoolCacheTy& cache);
-bool isProtectionCounterVariable(AllocaInst* var, Function* unprotectFunction, VarBoolCacheTy& cache);
+// widening at loop headers
+//   a loop that changes the counter or the depth in each iteration would
+//   otherwise produce a state for each value, up to MAX_COUNT or MAX_DEPTH
+//
+// the values are recorded per loop header and the rest of the state (other
+//   than the balance), so only states that differ just in the balance are
+//   compared; only a value first seen over a back edge is produced by the
+//   loop, and only such values are counted against the limits
 
-void handleBalanceForNonTerminator(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& counterVarsCache, VarBoolCacheTy& saveVarsCache,
+struct LoopBalanceTy { // values seen at a loop header, for one rest of the state
+  std::set<int> counts; // exact counter values
+  std::set<std::pair<bool, int>> depths; // differential, depth
+  unsigned nLoopCounts; // counts first seen over a back edge
+  unsigned nLoopDepths; // depths first seen over a back edge
+
+  LoopBalanceTy(): counts(), depths(), nLoopCounts(0), nLoopDepths(0) {};
+};
+
+void widenBalance(BalanceStateTy& b, LoopBalanceTy& seen, bool backEdge, LineMessenger& msg);
+
+bool isProtectionStackTopSaveVariable(AllocaInst* var, GlobalVariable* ppStackTopVariable);
+bool isProtectionCounterVariable(AllocaInst* var, Function* unprotectFunction);
+  // used to fill in VarTableTy, handlers look up the flags there
+
+void handleBalanceForNonTerminator(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarTableTy& vars,
     LineMessenger& msg, unsigned& refinableInfos);
 
-bool handleBalanceForTerminator(TerminatorInst* t, StateWithBalanceTy& s, GlobalsTy& g, VarBoolCacheTy& counterVarsCache,
+bool handleBalanceForTerminator(TerminatorInst* t, StateWithBalanceTy& s, GlobalsTy& g, VarTableTy& vars,
     LineMessenger& msg, unsigned& refinableInfos);
 
 #endif
@@ -16,12 +16,21 @@
 
 #include "common.h"
 
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
 #include <map>
 #include <set>
+#include <sstream>
 #include <stack>
 #include <unordered_set>
 #include <unordered_map>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Constants.h>
@@ -34,12 +43,15 @@
 #include "callocators.h"
 #include "allocators.h"
 #include "balance.h"
+#include "compactcfg.h"
 #include "freshvars.h"
 #include "guards.h"
 #include "linemsg.h"
 #include "symbols.h"
 #include "exceptions.h"
 #include "liveness.h"
+#include "prefilter.h"
+#include "vectors.h"
 
 using namespace llvm;
 
@@ -60,6 +72,7 @@ const bool SEPARATE_CHECKING = false;
   //   separate checking could be faster for certain programs where the
   //   state space with join checking would be growing rapidly
   //   (but in the end it seems so far it is usually not the case)
+  //   each check then runs with states that only have its own components
 
 const bool FULL_COMPARISON = true;
   // compare state precisely
@@ -74,6 +87,11 @@ const bool USE_ALLOCATOR_DETECTION = true;
   //   other times nil, will still be detected as an allocator [it would
   //   have been better to have a specific analysis for nullability]
 
+const bool VERIFY_EVENTS = false;
+  // (debugging) run the handlers that an instruction is not an event for
+  //   (see instructionHandlers) on a copy of the state, and fail an
+  //   assertion when they would change it or report a message
+
 // -------------------------
 const bool UNIQUE_MSG = !DEBUG && !TRACE && !DUMP_STATES;
   // Do not write more than one identical messages per source line of code. 
@@ -84,6 +102,90 @@ const bool UNIQUE_MSG = !DEBUG && !TRACE && !DUMP_STATES;
 const bool EXCLUDE_PROTECTION_FUNCTIONS = true;
   // if set to true, functions like protect, unprotect are not being checked (because they indeed cause imbalance)
 
+const bool JOIN_ON_TOO_MANY_STATES = true;
+  // when a function has too many states, check it again keeping only one
+  //   state per basic block (states reaching the same block are joined);
+  //   this always finishes, but guards are lost at joins and disagreeing
+  //   protection stacks make the checks confused, so only some messages
+  //   are reported (they are marked by JOINED_STATES_TAG)
+
+const bool JOIN_AT_REGIONS_FIRST = true;
+  // before joining all states, check the function again only joining
+  //   states entering a single-entry single-exit region (see CompactCFGTy)
+  //   beyond the first REGION_MAX_ENTRY_STATES; the regions are then
+  //   explored from a small set of entry states, but states not entering
+  //   a region more than that are kept precise
+
+const unsigned REGION_MAX_ENTRY_STATES = 32;
+
+const bool MERGE_COND_MSGS = true;
+  // merge states that only differ in conditional messages of fresh
+  //   variables, taking the union of the messages per variable; the merged
+  //   state has the same future, so the messages are the same, but its
+  //   successors may have to be visited again with the added messages
+
+const bool SYMBOLIC_INT_GUARDS = false;
+  // a state has a set of valuations of integer guards instead of just one,
+  //   states that only differ in them are merged (like with MERGE_COND_MSGS);
+  //   a state is only split by the valuations for blocks that read the
+  //   guards (branches on them, UNPROTECT with them), so the other checks
+  //   are not repeated for each valuation
+
+const bool PREDICT_PRECISION = true;
+  // pick the guards and join mode to start checking a function with, and
+  //   the budget of states for the first run, instead of always starting
+  //   without guards and learning about too many states at MAX_STATES;
+  //   the outcome recorded for the function in the history file (see
+  //   PRECISION_HISTORY_VARIABLE) is
+  //   used when available, otherwise a guess from static features of the
+  //   function (guards, loops, blocks, protection counters)
+
+const unsigned PREDICT_MAX_INT_GUARDS = 4; // start with int guards when there are at most this many
+const unsigned PREDICT_MAX_SEXP_GUARDS = 2; // start with SEXP guards when there are at most this many
+const unsigned PREDICT_BLOWUP_BUDGET_DIVISOR = 8;
+  // the first run of a function predicted to have too many states only
+  //   gets MAX_STATES / PREDICT_BLOWUP_BUDGET_DIVISOR states
+
+const char* const PRECISION_HISTORY_VARIABLE = "BCHECK_PRECISION_HISTORY";
+  // environment variable with the name of a file with outcomes of checking
+  //   functions in previous runs (guards, join mode), read at start and
+  //   updated at the end; no history is kept when not set
+
+const bool DROP_HOSTILE_GUARDS = true;
+  // stop tracking guards that split too many states of a function (counting
+  //   all valuations of symbolic int guards): a dropped guard is forgotten
+  //   like a dead guard for the rest of checking the function and reported,
+  //   and the hand-maintained lists of functions to avoid guards for
+  //   (exceptions.cpp) are then not used
+
+const unsigned HOSTILE_GUARDS_MIN_STATES = 100000; // visited states of a function before any guard is dropped
+const unsigned HOSTILE_GUARDS_WINDOW = 10000; // visited states between looking for guards to drop
+const unsigned HOSTILE_GUARD_SPLIT_PERCENT = 25; // drop a guard known with other than its most common value in this many percent of the valuations of a window
+
+const bool PREFILTER = true;
+  // skip functions that are trivially clean by their syntax (no SEXP
+  //   variables, no protection, no allocating calls), see prefilter.h;
+  //   this is done before the screen (TRIAGE) and any per-function setup
+
+const bool TRIAGE = false;
+  // before checking a function, run a cheap path-insensitive screen over
+  //   its protection and allocation events (screenFunction) and skip the
+  //   function when the screen proves it cannot have any messages; off
+  //   until VERIFY_TRIAGE has shown on a corpus that the messages do not
+  //   change
+
+const bool VERIFY_TRIAGE = false;
+  // check the functions skipped by the screen anyway and report those that
+  //   had any messages (to validate the screen on a corpus)
+
+const std::string JOINED_STATES_TAG = " [joined states, incomplete]";
+
+enum JoinModeTy {
+  JM_NONE = 0,
+  JM_REGIONS, // join states at region entries, beyond REGION_MAX_ENTRY_STATES
+  JM_ALL // join all states at a block
+};
+
 
 // -------------------------------- basic block state -----------------------------------
 
@@ -92,73 +194,405 @@ const int MAX_STATES = BCHECK_MAX_STATES;        // maximum number of states vis
 unsigned int nComparedEqual = 0;
 unsigned int nComparedDifferent = 0;
 
-struct StateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWithBalanceTy {
+// the state has only the components of the enabled checks
+//   (e.g. a balance-only run carries no fresh variables), the guards are
+//   always there, but are empty unless the guards are enabled
+
+struct NoBalanceTy {
+  NoBalanceTy(BasicBlock *bb) {};
+  void dump(bool verbose) {};
+};
+
+struct NoFreshVarsTy {
+  NoFreshVarsTy(BasicBlock *bb) {};
+  void dump(bool verbose) {};
+};
+
+// access to the components, NULL when not present
+
+static BalanceStateTy* balanceOf(StateWithBalanceTy& s) { return &s.balance; }
+static BalanceStateTy* balanceOf(NoBalanceTy& s) { return NULL; }
+
+static FreshVarsTy* freshVarsOf(StateWithFreshVarsTy& s) { return &s.freshVars; }
+static FreshVarsTy* freshVarsOf(NoFreshVarsTy& s) { return NULL; }
+
+static void forgetFreshVars(StateWithFreshVarsTy& s) { s.freshVars = FreshVarsTy(); }
+static void forgetFreshVars(NoFreshVarsTy& s) {}
+
+static bool handleBalanceForTerminator(TerminatorInst* t, NoBalanceTy& s, GlobalsTy& g, VarTableTy& vars,
+    LineMessenger& msg, unsigned& refinableInfos) {
+  return false;
+}
+
+static void widenBalance(StateWithBalanceTy& s, LoopBalanceTy& seen, bool backEdge, LineMessenger& msg) { widenBalance(s.balance, seen, backEdge, msg); }
+static void widenBalance(NoBalanceTy& s, LoopBalanceTy& seen, bool backEdge, LineMessenger& msg) {}
+
+static void hashBalance(size_t& res, const StateWithBalanceTy& s) {
+  hash_combine(res, s.balance.depth);
+  hash_combine(res, s.balance.count);
+  hash_combine(res, s.balance.savedDepth);
+  // not including topSaveVar
+  hash_combine(res, (int) s.balance.countState);
+}
+
+static void hashBalance(size_t& res, const NoBalanceTy& s) {}
+
+static size_t hashVars(const FreshVarsVarsTy& vars) {
+  size_t res = 0;
+  hash_combine(res, vars.size());
+  for(FreshVarsVarsTy::const_iterator fi = vars.begin(), fe = vars.end(); fi != fe; ++fi) {
+    AllocaInst* in = fi->first;
+    int pcount = fi->second;
+    hash_combine(res, (void *) in);
+    hash_combine(res, pcount);
+  } // ordered set
+  return res;
+}
+
+static size_t hashCondMsgs(const ConditionalMessagesTy& condMsgs) {
+  size_t res = 0;
+  hash_combine(res, condMsgs.size());
+  for(ConditionalMessagesTy::const_iterator mi = condMsgs.begin(), me = condMsgs.end(); mi != me; ++mi) {
+    hash_combine(res, (void *) mi->first);
+    hash_combine(res, (const void *) mi->second); // interned
+  } // ordered map
+  return res;
+}
+
+static size_t hashPStack(const VarsVectorTy& pstack) {
+  size_t res = 0;
+  hash_combine(res, pstack.size());
+  for(VarsVectorTy::const_iterator vi = pstack.begin(), ve = pstack.end(); vi != ve; ++vi) {
+    AllocaInst* var = *vi;
+    hash_combine(res, (void *) var);
+  }
+  return res;
+}
+
+// the components are only re-hashed when written since the state was cloned
+//   (the conditional messages are hashed separately for merging)
+static void hashFreshVars(size_t& res, const StateWithFreshVarsTy& s) {
+  hash_combine(res, s.freshVars.vars.hash(hashVars));
+  hash_combine(res, s.freshVars.pstack.hash(hashPStack));
+}
+
+static void hashFreshVars(size_t& res, const NoFreshVarsTy& s) {}
+
+static void hashFreshVarsCondMsgs(size_t& res, const StateWithFreshVarsTy& s) {
+  hash_combine(res, s.freshVars.condMsgs.hash(hashCondMsgs));
+}
+
+static void hashFreshVarsCondMsgs(size_t& res, const NoFreshVarsTy& s) {}
+
+static bool equalBalance(const StateWithBalanceTy& lhs, const StateWithBalanceTy& rhs) {
+  return lhs.balance.depth == rhs.balance.depth && lhs.balance.savedDepth == rhs.balance.savedDepth && lhs.balance.count == rhs.balance.count &&
+    lhs.balance.countState == rhs.balance.countState && lhs.balance.counterVar == rhs.balance.counterVar && lhs.balance.confused == rhs.balance.confused &&
+    lhs.balance.topSaveVar == rhs.balance.topSaveVar;
+}
+
+static bool equalBalance(const NoBalanceTy& lhs, const NoBalanceTy& rhs) { return true; }
+
+static bool equalFreshVars(const StateWithFreshVarsTy& lhs, const StateWithFreshVarsTy& rhs) { // but the conditional messages
+  return lhs.freshVars.vars == rhs.freshVars.vars && lhs.freshVars.pstack == rhs.freshVars.pstack
+    && lhs.freshVars.confused == rhs.freshVars.confused;
+}
+
+static bool equalFreshVars(const NoFreshVarsTy& lhs, const NoFreshVarsTy& rhs) { return true; }
+
+static bool equalFreshVarsCondMsgs(const StateWithFreshVarsTy& lhs, const StateWithFreshVarsTy& rhs) {
+  return lhs.freshVars.condMsgs == rhs.freshVars.condMsgs;
+}
+
+static bool equalFreshVarsCondMsgs(const NoFreshVarsTy& lhs, const NoFreshVarsTy& rhs) { return true; }
+
+// union of the conditional messages per variable, returns true when s changed
+static bool mergeFreshVarsCondMsgs(StateWithFreshVarsTy& s, const StateWithFreshVarsTy& other, LineMessenger& msg) {
+  if (s.freshVars.condMsgs == other.freshVars.condMsgs) {
+    return false;
+  }
+  ConditionalMessagesTy condMsgs(*s.freshVars.condMsgs);
+  bool changed = false;
+  for(ConditionalMessagesTy::const_iterator oi = other.freshVars.condMsgs->begin(), oe = other.freshVars.condMsgs->end(); oi != oe; ++oi) {
+    auto cinsert = condMsgs.insert(*oi);
+    if (cinsert.second) {
+      changed = true;
+      continue;
+    }
+    const LineInfoPtrSetTy* messages = cinsert.first->second;
+    for(LineInfoPtrSetTy::const_iterator li = oi->second->begin(), le = oi->second->end(); li != le; ++li) {
+      messages = msg.addToDelayedSet(messages, *li); // interned
+    }
+    if (messages != cinsert.first->second) {
+      cinsert.first->second = messages;
+      changed = true;
+    }
+  }
+  if (changed) {
+    s.freshVars.condMsgs = CowTy<ConditionalMessagesTy>(condMsgs);
+  }
+  return changed;
+}
+
+static bool mergeFreshVarsCondMsgs(NoFreshVarsTy& s, const NoFreshVarsTy& other, LineMessenger& msg) { return false; }
+
+// joining of components (when there are too many states), the result is
+//   stored in the first argument, returns true when that changed
+//
+// the components only lose information when joined, so a state at a block
+// can only change a bounded number of times
+
+template <class GuardsTy> static bool joinGuards(GuardsTy& guards, const GuardsTy& other) {
+  if (guards == other) {
+    return false;
+  }
+  GuardsTy unknown(guards);
+  unknown.clear();
+  if (guards == unknown) {
+    return false;
+  }
+  guards = unknown;
+  return true;
+}
+
+static bool joinBalance(StateWithBalanceTy& s, const StateWithBalanceTy& other) {
+  if (s.balance.confused || equalBalance(s, other)) {
+    return false;
+  }
+  s.balance.confused = true; // no more messages
+  return true;
+}
+
+static bool joinBalance(NoBalanceTy& s, const NoBalanceTy& other) { return false; }
+
+// keep only entries present and equal in both maps
+template <class MapTy> static bool intersectMaps(CowTy<MapTy>& map, const CowTy<MapTy>& other) {
+  if (map == other) {
+    return false;
+  }
+  MapTy res;
+  for(typename MapTy::const_iterator mi = map->begin(), me = map->end(); mi != me; ++mi) {
+    typename MapTy::const_iterator oi = other->find(mi->first);
+    if (oi != other->end() && oi->second == mi->second) {
+      res.insert(*mi);
+    }
+  }
+  if (res.size() == map->size()) {
+    return false;
+  }
+  map = CowTy<MapTy>(res);
+  return true;
+}
+
+static bool joinFreshVars(StateWithFreshVarsTy& s, const StateWithFreshVarsTy& other) {
+  FreshVarsTy& fv = s.freshVars;
+  const FreshVarsTy& ofv = other.freshVars;
+  
+  bool changed = intersectMaps(fv.vars, ofv.vars);
+  changed |= intersectMaps(fv.condMsgs, ofv.condMsgs);
+
+  if (!fv.confused && !(fv.pstack == ofv.pstack)) {
+    if (fv.pstack->size() != ofv.pstack->size()) {
+      fv.confused = true; // no more messages
+      changed = true;
+    } else {
+      // variables that differ become anonymous
+      VarsVectorTy pstack(*fv.pstack);
+      for(unsigned i = 0, n = pstack.size(); i < n; i++) {
+        if (pstack[i] != (*ofv.pstack)[i]) {
+          pstack[i] = NULL;
+        }
+      }
+      if (!(pstack == *fv.pstack)) {
+        fv.pstack = CowTy<VarsVectorTy>(pstack);
+        changed = true;
+      }
+    }
+  }
+  if (!fv.confused && ofv.confused) {
+    fv.confused = true;
+    changed = true;
+  }
+  return changed;
+}
+
+static bool joinFreshVars(NoFreshVarsTy& s, const NoFreshVarsTy& other) { return false; }
+
+// sets of valuations of integer guards (with SYMBOLIC_INT_GUARDS)
+
+struct IntGuardsTy_less {
+  bool operator()(const IntGuardsTy& lhs, const IntGuardsTy& rhs) const {
+    return lhs.zobrist < rhs.zobrist || (lhs.zobrist == rhs.zobrist && lhs.words < rhs.words);
+  }
+};
+
+typedef std::set<IntGuardsTy, IntGuardsTy_less> IntGuardsSetTy;
+
+static size_t hashIntGuardsSet(const IntGuardsSetTy& intGuardsSet) {
+  size_t res = 0;
+  hash_combine(res, intGuardsSet.size());
+  for(IntGuardsSetTy::const_iterator gi = intGuardsSet.begin(), ge = intGuardsSet.end(); gi != ge; ++gi) {
+    gi->hash(res);
+  } // ordered set
+  return res;
+}
+
+template <bool BALANCE, bool FRESH_VARS> struct StateTy : public StateWithGuardsTy,
+  public std::conditional<FRESH_VARS, StateWithFreshVarsTy, NoFreshVarsTy>::type,
+  public std::conditional<BALANCE, StateWithBalanceTy, NoBalanceTy>::type {
+
+  typedef typename std::conditional<FRESH_VARS, StateWithFreshVarsTy, NoFreshVarsTy>::type FreshVarsPartTy;
+  typedef typename std::conditional<BALANCE, StateWithBalanceTy, NoBalanceTy>::type BalancePartTy;
   
   size_t hashcode;
+  size_t mergeHashcode; // without the conditional messages (and the int guards, when symbolic)
   public:
-    StateTy(BasicBlock *bb): 
-      StateBaseTy(bb), StateWithGuardsTy(bb), StateWithFreshVarsTy(bb), StateWithBalanceTy(bb), hashcode(0) {};
+    static bool symbolicIntGuards; // for the function being checked
+
+    typedef std::unordered_multimap<size_t, std::pair<StateTy, LoopBalanceTy>> LoopBalancesTy;
+      // by hashWithoutBalance, the state is a representative of the states equal but the balance
+    static LoopBalancesTy* loopBalances; // for widening, of the function being checked
+
+    CowTy<IntGuardsSetTy> otherIntGuards;
+      // more valuations of the int guards (only when symbolic), all greater than intGuards
+    BasicBlock *sourceNode; // the node of the state this one was cloned from, for finding back edges (not hashed)
+
+    StateTy(BasicBlock *bb, const IntGuardsTy& intGuards, const SEXPGuardsTy& sexpGuards): 
+      StateBaseTy(bb), StateWithGuardsTy(bb, intGuards, sexpGuards), FreshVarsPartTy(bb), BalancePartTy(bb), hashcode(0), mergeHashcode(0),
+      otherIntGuards(), sourceNode(NULL) {};
 
-    StateTy(BasicBlock *bb, BalanceStateTy& balance, IntGuardsTy& intGuards, SEXPGuardsTy& sexpGuards, FreshVarsTy& freshVars):
-      StateBaseTy(bb), StateWithGuardsTy(bb, intGuards, sexpGuards), StateWithFreshVarsTy(bb, freshVars), StateWithBalanceTy(bb, balance), hashcode(0) {};
-      
     virtual StateTy* clone(BasicBlock *newBB) {
-      return new StateTy(newBB, balance, intGuards, sexpGuards, freshVars);
+      StateTy* s = new StateTy(*this); // the fresh vars components are shared until written
+      s->sourceNode = bb;
+      s->bb = newBB;
+      return s;
+    }
+
+    StateTy* moveTo(BasicBlock *newBB) { // like clone, but takes over the components, this state cannot be used afterwards
+      BasicBlock *from = bb;
+      StateTy* s = new StateTy(std::move(*this));
+      s->sourceNode = from;
+      s->bb = newBB;
+      return s;
     }
     
     virtual bool add();
+
+    LoopBalanceTy& loopBalance() { // values seen at the loop header bb for the states equal to this one but the balance
+      size_t h = hashWithoutBalance();
+      auto range = loopBalances->equal_range(h);
+      for(auto li = range.first; li != range.second; ++li) {
+        if (equalsWithoutBalance(li->second.first)) {
+          return li->second.second;
+        }
+      }
+      return loopBalances->insert({h, {*this, LoopBalanceTy()}})->second.second;
+    }
+
+    bool equalsWithoutBalance(const StateTy& other) const { // for widening at loop headers
+      return bb == other.bb && intGuards == other.intGuards && (!symbolicIntGuards || otherIntGuards == other.otherIntGuards) &&
+        sexpGuards == other.sexpGuards && equalFreshVars(*this, other) && equalFreshVarsCondMsgs(*this, other);
+    }
+
+    size_t hashWithoutBalance() const { // for widening at loop headers
+      size_t res = 0;
+      hash_combine(res, bb);
+      intGuards.hash(res);
+      if (symbolicIntGuards) {
+        hash_combine(res, otherIntGuards.hash(hashIntGuardsSet));
+      }
+      sexpGuards.hash(res);
+      hashFreshVars(res, *this);
+      hashFreshVarsCondMsgs(res, *this);
+      return res;
+    }
+
     void hash() {
       size_t res = 0;
       hash_combine(res, bb);
-      hash_combine(res, balance.depth);
-      hash_combine(res, balance.count);
-      hash_combine(res, balance.savedDepth);
-      // not including topSaveVar
-      hash_combine(res, (int) balance.countState);
-      hash_combine(res, intGuards.size());
-      for(IntGuardsTy::const_iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-        AllocaInst* var = gi->first;
-        IntGuardState s = gi->second;
-        hash_combine(res, (void *)var);
-        hash_combine(res, (char) s);
-      } // ordered map
-
-      hash_combine(res, sexpGuards.size());
-      for(SEXPGuardsTy::const_iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
-        AllocaInst* var = gi->first;
-        const SEXPGuardTy& g = gi->second;
-        hash_combine(res, (void *) var);
-        hash_combine(res, (char) g.state);
-        if (g.state == SGS_SYMBOL) {
-          hash_combine(res, g.symbolName);
-        }
-      } // ordered map
-
-      hash_combine(res, freshVars.vars.size());
-      for(FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe; ++fi) {
-        AllocaInst* in = fi->first;
-        int pcount = fi->second;
-        hash_combine(res, (void *) in);
-        hash_combine(res, pcount);
-      } // ordered set
-
-      hash_combine(res, freshVars.condMsgs.size());
-      for(ConditionalMessagesTy::iterator mi = freshVars.condMsgs.begin(), me = freshVars.condMsgs.end(); mi != me; ++mi) {
-        DelayedLineMessenger& msg = mi->second;
-        hash_combine(res, msg.size());
-        
-        for(LineInfoPtrSetTy::const_iterator li = msg.delayedLineBuffer.begin(), le = msg.delayedLineBuffer.end(); li != le; ++li) {
-          const LineInfoTy* l = *li;
-          hash_combine(res, (const void *) l);
+      hashBalance(res, *this);
+      if (!symbolicIntGuards) {
+        intGuards.hash(res);
+      }
+      sexpGuards.hash(res);
+      hashFreshVars(res, *this);
+      mergeHashcode = res;
+      if (symbolicIntGuards) {
+        intGuards.hash(res);
+        hash_combine(res, otherIntGuards.hash(hashIntGuardsSet));
+      }
+      hashFreshVarsCondMsgs(res, *this);
+      hashcode = res;
+    }
+
+    bool equals(const StateTy& other) const {
+      return mergeableWith(other) && equalFreshVarsCondMsgs(*this, other) &&
+        (!symbolicIntGuards || (intGuards == other.intGuards && otherIntGuards == other.otherIntGuards));
+    }
+
+    bool mergeableWith(const StateTy& other) const { // equal but the conditional messages (and the int guards, when symbolic)
+      return bb == other.bb && equalBalance(*this, other) && (symbolicIntGuards || intGuards == other.intGuards) && sexpGuards == other.sexpGuards &&
+        equalFreshVars(*this, other);
+    }
+
+    bool merge(const StateTy& other, LineMessenger& msg) { // returns true when changed
+      bool changed = mergeFreshVarsCondMsgs(*this, other, msg);
+      if (symbolicIntGuards) {
+        IntGuardsSetTy all(*otherIntGuards);
+        all.insert(intGuards);
+        size_t nvaluations = all.size();
+        all.insert(other.intGuards);
+        all.insert(other.otherIntGuards->begin(), other.otherIntGuards->end());
+        if (all.size() != nvaluations) {
+          setIntGuards(all);
+          changed = true;
         }
-      } // condMsgs is unordered
+      }
+      return changed;
+    }
+
+    void setIntGuards(IntGuardsSetTy& all) { // all valuations, not empty
+      intGuards = *all.begin();
+      all.erase(all.begin());
+      otherIntGuards = CowTy<IntGuardsSetTy>(all);
+    }
 
-      hash_combine(res, freshVars.pstack.size());
-      for(VarsVectorTy::iterator vi = freshVars.pstack.begin(), ve = freshVars.pstack.end(); vi != ve; ++vi) {
-        AllocaInst* var = *vi;
-        hash_combine(res, (void *) var);
+    template <class F> void forEachIntGuards(F f) { // applies f to all valuations of int guards
+      f(intGuards);
+      if (otherIntGuards->empty()) {
+        return;
       }
-      hashcode = res;
+      IntGuardsSetTy all;
+      all.insert(intGuards);
+      for(IntGuardsSetTy::const_iterator gi = otherIntGuards->begin(), ge = otherIntGuards->end(); gi != ge; ++gi) {
+        IntGuardsTy g(*gi);
+        f(g);
+        all.insert(g);
+      }
+      setIntGuards(all);
+    }
+
+    template <class F> void visitIntGuards(F f) const { // applies f to all valuations of int guards, without changing them
+      f(intGuards);
+      for(IntGuardsSetTy::const_iterator gi = otherIntGuards->begin(), ge = otherIntGuards->end(); gi != ge; ++gi) {
+        f(*gi);
+      }
+    }
+
+    void splitIntGuards(std::vector<StateTy>& variants) { // one state per valuation of int guards, this keeps the first
+      for(IntGuardsSetTy::const_iterator gi = otherIntGuards->begin(), ge = otherIntGuards->end(); gi != ge; ++gi) {
+        variants.push_back(*this);
+        variants.back().intGuards = *gi;
+        variants.back().otherIntGuards = CowTy<IntGuardsSetTy>();
+      }
+      otherIntGuards = CowTy<IntGuardsSetTy>();
+    }
+
+    bool join(const StateTy& other) { // returns true when changed
+      bool changed = joinGuards(intGuards, other.intGuards);
+      changed |= joinGuards(sexpGuards, other.sexpGuards);
+      changed |= joinBalance(*this, other);
+      changed |= joinFreshVars(*this, other);
+      return changed;
     }
 
     void dump() {
@@ -166,8 +600,8 @@ struct StateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWithBalanc
       errs() << " vvvvvvvvvvvvvvvvvvvvvv  " << std::to_string(hashcode) << " vvvvvvvvvvvvvvvvvvvvvv";
       StateBaseTy::dump(VERBOSE_DUMP);
       StateWithGuardsTy::dump(VERBOSE_DUMP);
-      StateWithFreshVarsTy::dump(VERBOSE_DUMP);
-      StateWithBalanceTy::dump(VERBOSE_DUMP);
+      FreshVarsPartTy::dump(VERBOSE_DUMP);
+      BalancePartTy::dump(VERBOSE_DUMP);
       errs() << " ^^^^^^^^^^^^^^^^^^^^^^  " << std::to_string(hashcode) << " ^^^^^^^^^^^^^^^^^^^^^^\n";
       errs().flush();
     }
@@ -177,14 +611,14 @@ struct StateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWithBalanc
 // the hashcode is cached at the time of first hashing
 //   (and indeed is not copied)
 
-struct StateTy_hash {
-  size_t operator()(const StateTy* t) const {
+template <class State> struct StateTy_hash {
+  size_t operator()(const State* t) const {
     return t->hashcode;
   }
 };
 
-struct StateTy_equal {
-  bool operator() (const StateTy* lhs, const StateTy* rhs) const {
+template <class State> struct StateTy_equal {
+  bool operator() (const State* lhs, const State* rhs) const {
 
     if (!FULL_COMPARISON) {
       return lhs->hashcode == rhs->hashcode;
@@ -192,18 +626,7 @@ struct StateTy_equal {
       // different hashcodes
     }
     
-    bool res;
-    if (lhs == rhs) {
-      res = true;
-    } else {
-      res = lhs->bb == rhs->bb && 
-      lhs->balance.depth == rhs->balance.depth && lhs->balance.savedDepth == rhs->balance.savedDepth && lhs->balance.count == rhs->balance.count &&
-      lhs->balance.countState == rhs->balance.countState && lhs->balance.counterVar == rhs->balance.counterVar && lhs->balance.confused == rhs->balance.confused &&
-      lhs->balance.topSaveVar == rhs->balance.topSaveVar &&
-      lhs->intGuards == rhs->intGuards && lhs->sexpGuards == rhs->sexpGuards &&
-      lhs->freshVars.vars == rhs->freshVars.vars && lhs->freshVars.condMsgs == rhs->freshVars.condMsgs && lhs->freshVars.pstack == rhs->freshVars.pstack
-         && lhs->freshVars.confused == rhs->freshVars.confused;
-    }
+    bool res = (lhs == rhs) || lhs->equals(*rhs);
     
     if (PROGRESS_MARKS) {
       if (res) {
@@ -216,23 +639,240 @@ struct StateTy_equal {
   }
 };
 
-typedef std::stack<StateTy*> WorkListTy;
-typedef std::unordered_set<StateTy*, StateTy_hash, StateTy_equal> DoneSetTy;
-
 // ------------- helper functions --------------
 
-DoneSetTy doneSet;
-WorkListTy workList;   
+unsigned long totalStates = 0;
+unsigned long totalMergedStates = 0;
+unsigned long totalSymbolicChecks = 0; // checks of functions with symbolic int guards
+unsigned long totalSplitStates = 0; // states visited once per valuation of their int guards
+unsigned long totalSplitValuations = 0;
+const CompactCFGTy* functionCFG = NULL; // of the function being checked
+const IntGuardsChecker* functionIntGuardsChecker = NULL;
+const SEXPGuardsChecker* functionSEXPGuardsChecker = NULL;
+const BasicBlocksSetTy* functionQuietBlocks = NULL;
+LineMessenger* functionMsg = NULL;
+
+template <bool BALANCE, bool FRESH_VARS> bool StateTy<BALANCE, FRESH_VARS>::symbolicIntGuards = false;
+template <bool BALANCE, bool FRESH_VARS> typename StateTy<BALANCE, FRESH_VARS>::LoopBalancesTy* StateTy<BALANCE, FRESH_VARS>::loopBalances = NULL;
+
+// states equal but the conditional messages, for merging
 
-bool StateTy::add() {
+template <class State> struct StateTy_mergeHash {
+  size_t operator()(const State* t) const {
+    return t->mergeHashcode;
+  }
+};
+
+template <class State> struct StateTy_mergeEqual {
+  bool operator() (const State* lhs, const State* rhs) const {
+    if (!FULL_COMPARISON) {
+      return lhs->mergeHashcode == rhs->mergeHashcode;
+    }
+    return (lhs == rhs) || lhs->mergeableWith(*rhs);
+  }
+};
+
+// the worklist and the doneset, one per kind of state
+//
+// states are added to the doneset in the order of ranks of their blocks
+// (see CompactCFGTy), a successor never has a lower rank; so once no state
+// of the lowest rank is pending in the worklist, no such state can be added
+// again and all states of that rank can be evicted from the doneset
+//   (this keeps the doneset close to the frontier of the search)
+//
+// a state that is joined is not in the doneset; there is at most one such
+// state per block and it is queued again when it changes by a join, so it
+// may be in the worklist more than once
+//
+// when merging, the doneset has at most one state that is equal but the
+// conditional messages (mergeSet has the same states), it is queued again
+// when it changes by a merge
+
+template <class State> struct StatesTy {
+  typedef std::stack<State*> WorkListTy;
+  typedef std::unordered_set<State*, StateTy_hash<State>, StateTy_equal<State>> DoneSetTy;
+  typedef std::vector<std::vector<State*>> StatesByRankTy;
+  typedef std::unordered_map<BasicBlock*, State*> JoinedTy;
+  typedef std::unordered_set<State*, StateTy_mergeHash<State>, StateTy_mergeEqual<State>> MergeSetTy;
+
+  static DoneSetTy doneSet;
+  static WorkListTy workList;
+
+  static unsigned long nAdded; // including the evicted states
+  static std::vector<unsigned> pendingByRank; // states in the worklist
+  static StatesByRankTy doneByRank; // states in the doneset
+  static unsigned lowestRank; // of states not evicted
+
+  static JoinModeTy joinMode;
+  static JoinedTy joined; // block -> its joined state
+  static std::unordered_map<BasicBlock*, unsigned> entryStates; // region entry -> number of states not joined
+
+  static bool merging;
+  static MergeSetTy mergeSet;
+  static unsigned long nMerged; // states merged into others
+
+  static void begin(unsigned nranks, JoinModeTy mode, bool merge) {
+    pendingByRank.assign(nranks, 0);
+    doneByRank.resize(nranks);
+    joinMode = mode;
+    merging = merge && mode != JM_ALL;
+  }
+
+  // true when a new state is to be joined with the joined state at its block
+  static bool isJoined(State *s) {
+    if (joinMode != JM_REGIONS || !functionCFG->isRegionEntry(s->bb)) {
+      return joinMode == JM_ALL;
+    }
+    if (doneSet.find(s) != doneSet.end()) {
+      return false; // not new
+    }
+    return entryStates[s->bb]++ >= REGION_MAX_ENTRY_STATES;
+  }
+
+  static void push(State *s) {
+    workList.push(s);
+    pendingByRank[functionCFG->rank(s->bb)]++;
+  }
+
+  // returns the state queued for s, if any (s itself unless joined)
+  static State* insert(State *s) {
+    if (isJoined(s)) {
+      auto jinsert = joined.insert({s->bb, s});
+      if (!jinsert.second) {
+        State *old = jinsert.first->second;
+        if (!old->join(*s)) {
+          return NULL;
+        }
+        push(old);
+        return old;
+      }
+    } else if (merging) {
+      auto minsert = mergeSet.insert(s);
+      if (!minsert.second) {
+        State *old = *minsert.first;
+        if (old->equals(*s)) {
+          return NULL;
+        }
+        nMerged++;
+        if (!old->merge(*s, *functionMsg)) {
+          return NULL;
+        }
+        doneSet.erase(old); // found by the old (cached) hashcode
+        old->hash();
+        doneSet.insert(old);
+        push(old);
+        return old;
+      }
+      doneSet.insert(s);
+    } else if (!doneSet.insert(s).second) {
+      return NULL;
+    }
+    unsigned rank = functionCFG->rank(s->bb);
+    myassert(rank >= lowestRank);
+    push(s);
+    doneByRank[rank].push_back(s);
+    nAdded++;
+    return s;
+  }
+
+  static State* pop() {
+    State *s = workList.top();
+    workList.pop();
+    pendingByRank[functionCFG->rank(s->bb)]--;
+    return s; // still owned by the doneset
+  }
+
+  static void evict() {
+    while(lowestRank < doneByRank.size() && pendingByRank[lowestRank] == 0) {
+      std::vector<State*>& states = doneByRank[lowestRank];
+      for(typename std::vector<State*>::iterator si = states.begin(), se = states.end(); si != se; ++si) {
+        State *old = *si;
+        auto ji = joined.find(old->bb);
+        if (ji != joined.end() && ji->second == old) {
+          joined.erase(ji);
+        } else {
+          doneSet.erase(old);
+          if (merging) {
+            mergeSet.erase(old);
+          }
+        }
+        delete old;
+      }
+      states.clear();
+      lowestRank++;
+    }
+  }
+
+  static void clear() {
+    // clear the worklist and the doneset
+    totalStates += nAdded;
+    for(typename DoneSetTy::iterator ds = doneSet.begin(), de = doneSet.end(); ds != de; ++ds) {
+      State *old = *ds;
+      delete old;
+    }
+    doneSet.clear();
+    for(typename JoinedTy::iterator ji = joined.begin(), je = joined.end(); ji != je; ++ji) {
+      State *old = ji->second;
+      delete old;
+    }
+    joined.clear();
+    entryStates.clear();
+    mergeSet.clear();
+    totalMergedStates += nMerged;
+    nMerged = 0;
+    WorkListTy empty;
+    std::swap(workList, empty);
+    // all elements in worklist are also in doneset (or joined), so no need to call destructors
+    nAdded = 0;
+    pendingByRank.clear();
+    doneByRank.clear();
+    lowestRank = 0;
+  }
+};
+
+template <class State> typename StatesTy<State>::DoneSetTy StatesTy<State>::doneSet;
+template <class State> typename StatesTy<State>::WorkListTy StatesTy<State>::workList;
+template <class State> unsigned long StatesTy<State>::nAdded = 0;
+template <class State> std::vector<unsigned> StatesTy<State>::pendingByRank;
+template <class State> typename StatesTy<State>::StatesByRankTy StatesTy<State>::doneByRank;
+template <class State> unsigned StatesTy<State>::lowestRank = 0;
+template <class State> JoinModeTy StatesTy<State>::joinMode = JM_NONE;
+template <class State> typename StatesTy<State>::JoinedTy StatesTy<State>::joined;
+template <class State> std::unordered_map<BasicBlock*, unsigned> StatesTy<State>::entryStates;
+template <class State> bool StatesTy<State>::merging = false;
+template <class State> typename StatesTy<State>::MergeSetTy StatesTy<State>::mergeSet;
+template <class State> unsigned long StatesTy<State>::nMerged = 0;
+
+template <bool BALANCE, bool FRESH_VARS> bool StateTy<BALANCE, FRESH_VARS>::add() {
+  typedef StatesTy<StateTy> States;
+
+  bb = functionCFG->node(bb);
+  if (!bb) { // on error path
+    delete this; // NOTE: state suicide
+    return false;
+  }
+  if (functionQuietBlocks->find(bb) != functionQuietBlocks->end()) {
+    forEachIntGuards([](IntGuardsTy& g) { g.clear(); });
+    sexpGuards.clear();
+    forgetFreshVars(*this);
+  } else {
+    BasicBlock *node = bb;
+    forEachIntGuards([node](IntGuardsTy& g) { functionIntGuardsChecker->forgetDeadGuards(node, g); });
+    functionSEXPGuardsChecker->forgetDeadGuards(bb, sexpGuards);
+  }
+  if (BALANCE && functionCFG->isLoopHeader(bb)) {
+    bool backEdge = sourceNode && functionCFG->isBackEdge(functionCFG->blocks(sourceNode).back(), bb);
+    widenBalance(*this, loopBalance(), backEdge, *functionMsg);
+  }
   hash(); // precompute hashcode
-  auto sinsert = doneSet.insert(this);
-  if (sinsert.second) {
-    workList.push(this);
+  if (StateTy *queued = States::insert(this)) {
     if (DUMP_STATES && (DUMP_STATES_FUNCTION.empty() || DUMP_STATES_FUNCTION == bb->getParent()->getName())) {
       outs().flush();
       errs() << "\n -- dumping a new state being added -- \n";
-      workList.top()->dump();
+      queued->dump();
+    }
+    if (queued != this) { // joined into queued
+      delete this; // NOTE: state suicide
     }
     return true;
   } else {
@@ -241,22 +881,8 @@ bool StateTy::add() {
   }
 }
 
-unsigned long totalStates = 0;
-
-void clearStates() {
-  // clear the worklist and the doneset
-  totalStates += doneSet.size();
-  for(DoneSetTy::iterator ds = doneSet.begin(), de = doneSet.end(); ds != de; ++ds) {
-    StateTy *old = *ds;
-    delete old;
-  }
-  doneSet.clear();
-  WorkListTy empty;
-  std::swap(workList, empty);
-  // all elements in worklist are also in doneset, so no need to call destructors
-}
-
-void handleUnprotectWithIntGuard(Instruction *in, StateTy& s, GlobalsTy& g, IntGuardsChecker& intGuardsChecker, LineMessenger& msg, unsigned& refinableInfos) { 
+void handleUnprotectWithIntGuard(Instruction *in, BalanceStateTy& balance, IntGuardsTy& intGuards, GlobalsTy& g, IntGuardsChecker& intGuardsChecker,
+    LineMessenger& msg, unsigned& refinableInfos) { 
   
   // UNPROTECT(intguard ? 3 : 4)
   
@@ -305,7 +931,7 @@ void handleUnprotectWithIntGuard(Instruction *in, StateTy& s, GlobalsTy& g, IntG
     return;
   }
                   
-  IntGuardState gs = intGuardsChecker.getGuardState(s.intGuards, cast<AllocaInst>(guardValue));
+  IntGuardState gs = intGuardsChecker.getGuardState(intGuards, cast<AllocaInst>(guardValue));
                     
   if (gs != IGS_UNKNOWN) {
     uint64_t arg; 
@@ -314,15 +940,114 @@ void handleUnprotectWithIntGuard(Instruction *in, StateTy& s, GlobalsTy& g, IntG
     } else {
       arg = cast<ConstantInt>(si->getFalseValue())->getZExtValue();
     }
-    s.balance.depth -= (int) arg;
+    balance.depth -= (int) arg;
     msg.debug("unprotect call using constant in conditional expression on integer guard", in);              
-    if (s.balance.countState != CS_DIFF && s.balance.depth < 0) {
+    if (balance.countState != CS_DIFF && balance.depth < 0) {
       msg.info("has negative depth", in);
       refinableInfos++;
     }
   }
 }
 
+// ------------- hostile guards --------------
+
+// how many visited valuations of guards had each known value of each guard
+//   (see DROP_HOSTILE_GUARDS), a state may have more valuations of int
+//   guards (SYMBOLIC_INT_GUARDS)
+
+template <unsigned BITS> class GuardValueCountsTy {
+
+  static const unsigned NVALUES = 1 << BITS;
+  std::vector<unsigned long> counts; // by guard index and value
+  unsigned long nvaluations;
+
+  public:
+    GuardValueCountsTy(unsigned nguards): counts(nguards * NVALUES, 0), nvaluations(0) {};
+
+    void add(const FlatGuardsTy<BITS>& guards) {
+      nvaluations++;
+      for(unsigned idx = 0, nguards = counts.size() / NVALUES; idx < nguards; idx++) {
+        unsigned value = guards.getAt(idx);
+        if (value) {
+          counts[idx * NVALUES + value]++;
+        }
+      }
+    }
+
+    unsigned long getNValuations() const {
+      return nvaluations;
+    }
+
+    // valuations with a known value of the guard other than its most common one
+    unsigned long split(unsigned idx) const {
+      unsigned long known = 0;
+      unsigned long most = 0;
+      for(unsigned value = 1; value < NVALUES; value++) {
+        unsigned long c = counts[idx * NVALUES + value];
+        known += c;
+        most = std::max(most, c);
+      }
+      return known - most;
+    }
+
+    void clear() {
+      std::fill(counts.begin(), counts.end(), 0);
+      nvaluations = 0;
+    }
+};
+
+// ------------- checking outcomes --------------
+
+struct CheckingOutcomeTy { // the precision a function ended up being checked with
+  bool intGuards;
+  bool sexpGuards;
+  JoinModeTy joinMode;
+};
+
+typedef std::map<std::string, CheckingOutcomeTy> CheckingOutcomesTy; // function name and checks name -> outcome
+
+CheckingOutcomesTy checkingOutcomes; // from the history file, updated as functions are checked
+
+struct PredictionStatsTy {
+  unsigned nFromHistory;
+  unsigned nPrecisionSufficed; // the starting guards were kept
+  unsigned nPrecisionRefined; // more guards were enabled on a restart
+  unsigned nBlowupsPredicted;
+  unsigned nBlowupsConfirmed; // predicted and ran out of states
+  unsigned nBlowupsMissed; // not predicted, but ran out of states
+};
+
+PredictionStatsTy predictionStats = {0, 0, 0, 0, 0, 0};
+
+// one line per function: int guards, SEXP guards, join mode, name
+
+static void readCheckingOutcomes(const std::string& fname, CheckingOutcomesTy& outcomes) {
+  std::ifstream in(fname);
+  std::string line;
+  while(std::getline(in, line)) {
+    std::istringstream ls(line);
+    CheckingOutcomeTy o;
+    unsigned joinMode;
+    std::string name;
+    if (!(ls >> o.intGuards >> o.sexpGuards >> joinMode) || joinMode > JM_ALL || !std::getline(ls >> std::ws, name)) {
+      continue;
+    }
+    o.joinMode = (JoinModeTy) joinMode;
+    outcomes[name] = o;
+  }
+}
+
+static void writeCheckingOutcomes(const std::string& fname, const CheckingOutcomesTy& outcomes) {
+  std::ofstream out(fname);
+  for(CheckingOutcomesTy::const_iterator oi = outcomes.begin(), oe = outcomes.end(); oi != oe; ++oi) {
+    const CheckingOutcomeTy& o = oi->second;
+    out << o.intGuards << " " << o.sexpGuards << " " << (unsigned) o.joinMode << " " << oi->first << "\n";
+  }
+  if (!out) {
+    errs() << "ERROR: cannot write " << fname << "\n";
+  }
+}
+
 struct ModuleCheckingStateTy {
   FunctionsSetTy& possibleAllocators;
   FunctionsSetTy& allocatingFunctions;
@@ -337,36 +1062,357 @@ struct ModuleCheckingStateTy {
     possibleAllocators(possibleAllocators), allocatingFunctions(allocatingFunctions), errorFunctions(errorFunctions), gl(gl), msg(msg), cm(cm), cprotect(cprotect) {};
 };
 
+// the instructions of a basic block some of the handlers may act on, each
+//   with a mask of these handlers
+//
+// computed once per function, so that instructions irrelevant to all
+// handlers cost nothing when a block is visited again (with another state)
+
+enum InstructionHandler {
+  IH_FRESH_VARS = 1 << 0,
+  IH_BALANCE = 1 << 1,
+  IH_INT_GUARDS = 1 << 2,
+  IH_SEXP_GUARDS = 1 << 3,
+  IH_UNPROTECT_WITH_INT_GUARD = 1 << 4
+};
+
+struct InstructionEventTy {
+  Instruction *in;
+  unsigned handlers;
+  unsigned storedFunId; // storedCallTargetId(in), for the sexp guards handler
+};
+
+typedef std::vector<InstructionEventTy> BlockEventsTy;
+typedef std::unordered_map<BasicBlock*, BlockEventsTy> BlockEventsMapTy;
+
+// conservative: a handler not in the result would not do anything for the instruction
+static unsigned instructionHandlers(Instruction *in, GlobalsTy& g, VarTableTy& vars) {
+
+  unsigned res = 0;
+  AllocaInst* vvar;
+  if (isVectorOnlyVarOperation(in, vvar)) {
+    res |= IH_SEXP_GUARDS;
+  }
+
+  CallSite cs(in);
+  if (cs) {
+    Function *f = cs.getCalledFunction();
+    if (!f) {
+      return res;
+    }
+    res |= IH_FRESH_VARS;
+    if (f == g.protectFunction || f == g.protectWithIndexFunction || f == g.unprotectFunction || f == g.unprotectPtrFunction) {
+      res |= IH_BALANCE;
+    }
+    if (f == g.unprotectFunction) {
+      res |= IH_UNPROTECT_WITH_INT_GUARD;
+    }
+    return res;
+  }
+
+  if (LoadInst *li = dyn_cast<LoadInst>(in)) {
+    Value *ptr = li->getPointerOperand();
+    if (AllocaInst *var = dyn_cast<AllocaInst>(ptr)) {
+      if (vars.isSEXP(var)) { // fresh variables and conditional messages are only of SEXP type
+        res |= IH_FRESH_VARS;
+      }
+    }
+    if (ptr == g.ppStackTopVariable) {
+      res |= IH_BALANCE;
+    }
+    return res;
+  }
+
+  if (StoreInst *si = dyn_cast<StoreInst>(in)) {
+    res |= IH_FRESH_VARS;
+    Value *ptr = si->getPointerOperand();
+    if (ptr == g.ppStackTopVariable) {
+      res |= IH_BALANCE;
+    }
+    if (AllocaInst *var = dyn_cast<AllocaInst>(ptr)) {
+      unsigned vflags = vars.get(var);
+      if (vflags & VF_COUNTER) {
+        res |= IH_BALANCE;
+      }
+      if (vflags & VF_INT_GUARD) {
+        res |= IH_INT_GUARDS;
+      }
+      if (vflags & VF_SEXP_GUARD) {
+        res |= IH_SEXP_GUARDS;
+      }
+    }
+  }
+  return res;
+}
+
+static void findBlockEvents(Function *fun, GlobalsTy& g, VarTableTy& vars, CalledModuleTy& cm, BlockEventsMapTy& blockEvents) {
+
+  blockEvents.clear();
+  for(Function::iterator bi = fun->begin(), be = fun->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    BlockEventsTy& events = blockEvents[bb];
+    for(BasicBlock::iterator ini = bb->begin(), ine = bb->end(); ini != ine; ++ini) {
+      Instruction *in = &*ini;
+      unsigned handlers = instructionHandlers(in, g, vars);
+      if (handlers) {
+        unsigned storedFunId = (handlers & IH_SEXP_GUARDS) ? storedCallTargetId(in, &cm) : FunctionIdsTy::NONE;
+        events.push_back({in, handlers, storedFunId});
+      }
+    }
+  }
+}
+
+// a path-insensitive screen for functions that cannot have any messages
+//
+// the balance check and the protect stack of the fresh variables check
+//   need protection events (calls to PROTECT/UNPROTECT, counter variables,
+//   PPStackTop), fresh variables need an object returned by a possible
+//   allocator to exist at a call to an allocating function; so a function
+//   is clean when it has no protection events, the fresh variables check
+//   does not ignore any of its SEXP variables (with address taken), and no
+//   call to an allocating function (or an unknown function) can be reached
+//   from a call to a possible allocator
+//
+// error functions are not counted as allocating, because bcheck does not
+//   check error paths
+
+static bool screenFunction(Function *fun, GlobalsTy& g, VarTableTy& vars, const FunctionsSetTy& possibleAllocators,
+    const FunctionsSetTy& allocatingFunctions, const FunctionsSetTy& errorFunctions) {
+
+  if (vars.count(VF_COUNTER | VF_SAVE) || vars.count(VF_SEXP) != vars.count(VF_CHECKED_FRESH)) {
+    return false;
+  }
+
+  BasicBlocksSetTy allocating; // blocks with a call to an allocating function
+  BasicBlocksVectorTy workList; // blocks entered after a call to a possible allocator
+  for(Function::iterator bi = fun->begin(), be = fun->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    bool fresh = false;
+    for(BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
+      Instruction *in = &*ii;
+      if (instructionHandlers(in, g, vars) & IH_BALANCE) {
+        return false;
+      }
+      CallSite cs(in);
+      if (!cs) {
+        continue;
+      }
+      Function *f = cs.getCalledFunction();
+      if (!f || (allocatingFunctions.find(f) != allocatingFunctions.end() && errorFunctions.find(f) == errorFunctions.end())) {
+        if (fresh) {
+          return false;
+        }
+        allocating.insert(bb);
+      }
+      if (f && possibleAllocators.find(f) != possibleAllocators.end()) {
+        fresh = true;
+      }
+    }
+    if (fresh) {
+      for(succ_iterator si = succ_begin(bb), se = succ_end(bb); si != se; ++si) {
+        workList.push_back(*si);
+      }
+    }
+  }
+
+  BasicBlocksSetTy visited;
+  while(!workList.empty()) {
+    BasicBlock *bb = workList.back();
+    workList.pop_back();
+    if (!visited.insert(bb).second) {
+      continue;
+    }
+    if (allocating.find(bb) != allocating.end()) {
+      return false;
+    }
+    for(succ_iterator si = succ_begin(bb), se = succ_end(bb); si != se; ++si) {
+      workList.push_back(*si);
+    }
+  }
+  return true;
+}
+
+// a terminator the balance handler acts on: if (nprotect) ...
+static bool isBalanceTerminator(TerminatorInst *t, VarTableTy& vars) {
+
+  BranchInst *br = dyn_cast<BranchInst>(t);
+  if (!br || !br->isConditional()) {
+    return false;
+  }
+  CmpInst *ci = dyn_cast<CmpInst>(br->getCondition());
+  if (!ci) {
+    return false;
+  }
+  for(unsigned i = 0; i < 2; i++) {
+    LoadInst *li = dyn_cast<LoadInst>(ci->getOperand(i));
+    if (!li) {
+      continue;
+    }
+    AllocaInst *var = dyn_cast<AllocaInst>(li->getPointerOperand());
+    if (var && vars.isProtectionCounter(var)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// blocks from which no instruction that any of the checks acts on is
+//   reachable, apart from returns
+//
+// a state in such block can only be reported at return for imbalance, so
+// the guards and fresh variables of the state are forgotten, and states
+// with the same balance are merged
+
+static void findQuietBlocks(Function *fun, VarTableTy& vars, BlockEventsMapTy& blockEvents, BasicBlocksSetTy& quietBlocks) {
+
+  BasicBlocksSetTy relevant;
+  std::vector<BasicBlock*> workList;
+  for(Function::iterator bi = fun->begin(), be = fun->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    if (!blockEvents.at(bb).empty() || isBalanceTerminator(bb->getTerminator(), vars)) {
+      relevant.insert(bb);
+      workList.push_back(bb);
+    }
+  }
+  while(!workList.empty()) {
+    BasicBlock *bb = workList.back();
+    workList.pop_back();
+    for(pred_iterator pi = pred_begin(bb), pe = pred_end(bb); pi != pe; ++pi) {
+      if (relevant.insert(*pi).second) {
+        workList.push_back(*pi);
+      }
+    }
+  }
+  quietBlocks.clear();
+  for(Function::iterator bi = fun->begin(), be = fun->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    if (relevant.find(bb) == relevant.end()) {
+      quietBlocks.insert(bb);
+    }
+  }
+}
+
 class FunctionChecker {
 
   Function *fun;
-  VarBoolCacheTy saveVarsCache;
-  VarBoolCacheTy counterVarsCache;
-  VarBoolCacheTy checkedVarsCache;
+  VarTableTy& vars;
+  BlockEventsMapTy blockEvents;
+  BasicBlocksSetTy quietBlocks;
+  CompactCFGTy cfg;
   IntGuardsChecker intGuardsChecker;
   SEXPGuardsChecker sexpGuardsChecker;
   BasicBlocksSetTy errorBasicBlocks;
   LiveVarsTy liveVars;
+  unsigned long maxStates; // budget of the current run
 
   ModuleCheckingStateTy& m;
 
-  void checkFunction(bool intGuardsEnabled, bool sexpGuardsEnabled, bool balanceCheckingEnabled, bool freshVarsCheckingEnabled, unsigned& refinableInfos) {
+  // true when visiting the node needs to know the value of an int guard
+  bool readsIntGuards(const BasicBlocksVectorTy& chain, TerminatorInst *t) {
+    for(BasicBlocksVectorTy::const_iterator bi = chain.begin(), be = chain.end(); bi != be; ++bi) {
+      const BlockEventsTy& events = blockEvents.at(*bi);
+      for(BlockEventsTy::const_iterator ei = events.begin(), ee = events.end(); ei != ee; ++ei) {
+        if (ei->handlers & IH_UNPROTECT_WITH_INT_GUARD) {
+          return true;
+        }
+      }
+    }
+    return intGuardsChecker.getBranchGuard(t) != NULL;
+  }
+
+  // without DROP_HOSTILE_GUARDS, guards are avoided for functions listed in exceptions.cpp
+  bool avoidIntGuards() const { return !DROP_HOSTILE_GUARDS && avoidIntGuardsFor(fun); }
+  bool avoidSEXPGuards() const { return !DROP_HOSTILE_GUARDS && avoidSEXPGuardsFor(fun); }
+
+  // drops the guards splitting too many of the states counted, see DROP_HOSTILE_GUARDS
+  template <unsigned BITS, class GuardsChecker> void dropHostileGuards(GuardsChecker& checker, GuardValueCountsTy<BITS>& counts,
+      const std::string& kind) {
+
+    unsigned long nvaluations = counts.getNValuations();
+    for(unsigned idx = 0, nguards = checker.getNGuards(); idx < nguards; idx++) {
+      unsigned long split = counts.split(idx);
+      if (split * 100 >= nvaluations * HOSTILE_GUARD_SPLIT_PERCENT && checker.dropGuard(idx)) {
+        errs() << "NOTE: dropped " << kind << " guard " << varName(checker.getGuardVar(idx)) << " in function " << funName(fun) <<
+          " (split " << split << " of " << nvaluations << " valuations)\n";
+      }
+    }
+    counts.clear();
+  }
+
+  // with VERIFY_EVENTS, the handlers not in the mask of an instruction must do nothing for state s
+  template <bool INT_GUARDS, bool SEXP_GUARDS, bool BALANCE, bool FRESH_VARS, class State> void verifySkippedHandlers(Instruction *in, unsigned handlers, const State& s) {
+    State c(s);
+    unsigned infos = 0;
+    unsigned long nReported = m.msg.getNReported();
+
+    if (FRESH_VARS && !(handlers & IH_FRESH_VARS)) {
+      handleFreshVarsForNonTerminator(in, &m.cm, SEXP_GUARDS ? &sexpGuardsChecker : NULL, SEXP_GUARDS ? &c.sexpGuards : NULL, *freshVarsOf(c),
+        m.msg, infos, liveVars, m.cprotect, balanceOf(c), vars);
+    }
+    if (BALANCE && !(handlers & IH_BALANCE)) {
+      handleBalanceForNonTerminator(in, *balanceOf(c), m.gl, vars, m.msg, infos);
+    }
+    if (INT_GUARDS && !(handlers & IH_INT_GUARDS)) {
+      c.forEachIntGuards([this, in](IntGuardsTy& g) { intGuardsChecker.handleForNonTerminator(in, g); });
+    }
+    if (INT_GUARDS && BALANCE && !(handlers & IH_UNPROTECT_WITH_INT_GUARD)) {
+      handleUnprotectWithIntGuard(in, *balanceOf(c), c.intGuards, m.gl, intGuardsChecker, m.msg, infos);
+    }
+    if (SEXP_GUARDS && !(handlers & IH_SEXP_GUARDS)) {
+      sexpGuardsChecker.handleForNonTerminator(in, c.sexpGuards, storedCallTargetId(in, &m.cm));
+    }
+    myassert(c.equals(s) && infos == 0 && m.msg.getNReported() == nReported);
+  }
+
+  template <class State> static bool nextVariant(State& s, std::vector<State>& variants) {
+    if (variants.empty()) {
+      return false;
+    }
+    s = std::move(variants.back());
+    variants.pop_back();
+    return true;
+  }
+
+  // the checking loop, specialized for the enabled checks
+  //   (handlers of disabled checks compile away)
+  //   returns false when there were too many states
+
+  template <bool INT_GUARDS, bool SEXP_GUARDS, bool BALANCE, bool FRESH_VARS> bool checkFunction(JoinModeTy joinMode, unsigned& refinableInfos) {
+
+    typedef StateTy<BALANCE, FRESH_VARS> State;
+    typedef StatesTy<State> States;
+    typename States::WorkListTy& workList = States::workList;
   
     refinableInfos = 0;
-    bool restartable = (!intGuardsEnabled && !avoidIntGuardsFor(fun)) || (!sexpGuardsEnabled && !avoidSEXPGuardsFor(fun));
-    clearStates();
+    bool restartable = joinMode == JM_NONE && ((!INT_GUARDS && !avoidIntGuards()) || (!SEXP_GUARDS && !avoidSEXPGuards()));
+    functionCFG = &cfg;
+    functionIntGuardsChecker = &intGuardsChecker;
+    functionSEXPGuardsChecker = &sexpGuardsChecker;
+    functionQuietBlocks = &quietBlocks;
+    typename State::LoopBalancesTy loopBalances;
+    State::loopBalances = &loopBalances;
+    functionMsg = &m.msg;
+    State::symbolicIntGuards = INT_GUARDS && SYMBOLIC_INT_GUARDS && joinMode == JM_NONE;
+    if (State::symbolicIntGuards) {
+      totalSymbolicChecks++;
+    }
+    States::begin(cfg.getNRanks(), joinMode, (FRESH_VARS && MERGE_COND_MSGS) || State::symbolicIntGuards);
+    GuardValueCountsTy<IGS_BITS> intGuardCounts(INT_GUARDS ? intGuardsChecker.getNGuards() : 0);
+    GuardValueCountsTy<SGS_BITS> sexpGuardCounts(SEXP_GUARDS ? sexpGuardsChecker.getNGuards() : 0);
+    unsigned long nVisited = 0;
     {
-      StateTy* initState = new StateTy(&fun->getEntryBlock());
+      State* initState = new State(&fun->getEntryBlock(), intGuardsChecker.emptyGuards(), sexpGuardsChecker.emptyGuards());
       initState->add();
     }
     while(!workList.empty()) {
       if (restartable && refinableInfos > 0) {
-        clearStates();
-        return;
+        States::clear();
+        return true;
       }
+      States::evict();
       
       if (ONLY_FUNCTION && ONLY_FUNCTION_NAME != fun->getName()) {
-        workList.pop();
+        States::pop();
         continue;
       }
       
@@ -376,132 +1422,286 @@ class FunctionChecker {
         workList.top()->dump();
       }
 
-      StateTy s(*workList.top());
-      workList.pop();
+      State s(*States::pop()); // a copy, the popped state stays in the done set (the fresh vars components are shared until written)
       m.msg.trace("going to work on this state:", &*s.bb->begin());
-      
-      if (errorBasicBlocks.find(s.bb) != errorBasicBlocks.end()) {
-        m.msg.debug("ignoring basic block on error path", &*s.bb->begin());
-        continue;
+
+      if (DROP_HOSTILE_GUARDS && (INT_GUARDS || SEXP_GUARDS)) {
+        if (INT_GUARDS) {
+          s.visitIntGuards([&intGuardCounts](const IntGuardsTy& g) { intGuardCounts.add(g); });
+        }
+        if (SEXP_GUARDS) {
+          sexpGuardCounts.add(s.sexpGuards);
+        }
+        if (++nVisited % HOSTILE_GUARDS_WINDOW == 0) {
+          if (nVisited < HOSTILE_GUARDS_MIN_STATES) {
+            intGuardCounts.clear();
+            sexpGuardCounts.clear();
+          } else {
+            if (INT_GUARDS) {
+              dropHostileGuards(intGuardsChecker, intGuardCounts, "int");
+            }
+            if (SEXP_GUARDS) {
+              dropHostileGuards(sexpGuardsChecker, sexpGuardCounts, "SEXP");
+            }
+          }
+        }
       }
       
-      if (doneSet.size() > MAX_STATES) {
-        errs() << "ERROR: too many states (abstraction error?) in function " << funName(fun) << "\n";
-        clearStates();
-        return;
+      if (States::nAdded > maxStates) {
+        States::clear();
+        return false;
       }
       
       if (PROGRESS_MARKS) {
-        if (doneSet.size() % PROGRESS_STEP == 0) {
+        if (States::nAdded % PROGRESS_STEP == 0) {
           errs() << "current worklist:" << std::to_string(workList.size()) << " current function:" << funName(fun) <<
-            " done:" << std::to_string(doneSet.size()) << " equal:" << nComparedEqual << " different:" << nComparedDifferent << "\n";
+            " done:" << std::to_string(States::nAdded) << " kept:" << std::to_string(States::doneSet.size()) << " merged:" << std::to_string(States::nMerged) << " equal:" << nComparedEqual << " different:" << nComparedDifferent << "\n";
         }
       }      
       
-      // process a single basic block
-      for(BasicBlock::iterator ini = s.bb->begin(), ine = s.bb->end(); ini != ine; ++ini) {
-        Instruction *in = &*ini;
-        m.msg.trace("visiting", in);
+      // process a node of the compacted cfg (a chain of basic blocks)
+      const BasicBlocksVectorTy& chain = cfg.blocks(s.bb);
+      TerminatorInst *t = chain.back()->getTerminator(); // the others are unconditional branches
+
+      // with symbolic int guards, each valuation is visited separately when the node reads the guards
+      std::vector<State> variants;
+      if (INT_GUARDS && !s.otherIntGuards->empty() && readsIntGuards(chain, t)) {
+        s.splitIntGuards(variants);
+        totalSplitStates++;
+        totalSplitValuations += variants.size() + 1;
+      }
+      do {
+        for(BasicBlocksVectorTy::const_iterator bi = chain.begin(), be = chain.end(); bi != be; ++bi) {
+          const BlockEventsTy& events = blockEvents.at(*bi);
+          BasicBlock::iterator vi = (*bi)->begin(); // the next instruction to verify (VERIFY_EVENTS)
+          for(BlockEventsTy::const_iterator ei = events.begin(), ee = events.end(); ei != ee; ++ei) {
+            Instruction *in = ei->in;
+            unsigned handlers = ei->handlers;
+            m.msg.trace("visiting", in);
+            if (VERIFY_EVENTS) {
+              for(; &*vi != in; ++vi) {
+                verifySkippedHandlers<INT_GUARDS, SEXP_GUARDS, BALANCE, FRESH_VARS>(&*vi, 0, s);
+              }
+              verifySkippedHandlers<INT_GUARDS, SEXP_GUARDS, BALANCE, FRESH_VARS>(in, handlers, s);
+              ++vi;
+            }
+     
+            if (FRESH_VARS && (handlers & IH_FRESH_VARS)) {
+              handleFreshVarsForNonTerminator(in, &m.cm, SEXP_GUARDS ? &sexpGuardsChecker : NULL, SEXP_GUARDS ? &s.sexpGuards : NULL, *freshVarsOf(s), 
+                m.msg, refinableInfos, liveVars, m.cprotect, balanceOf(s), vars);
+                  // NOTE: must be called before balance handling
+                  //  because it uses some state of balance handling that will be removed by the call to
+                  //  handleBalanceForNonTerminator, e.g. re protection counter or topsave variable
+              
+              if (restartable && refinableInfos > 0) { States::clear(); return true; }
+            }
+            if (BALANCE && (handlers & IH_BALANCE)) {
+              handleBalanceForNonTerminator(in, *balanceOf(s), m.gl, vars, m.msg, refinableInfos);
+              if (restartable && refinableInfos > 0) { States::clear(); return true; }
+            }
    
-        if (freshVarsCheckingEnabled) {
-          handleFreshVarsForNonTerminator(in, &m.cm, sexpGuardsEnabled ? &sexpGuardsChecker : NULL, sexpGuardsEnabled ? &s.sexpGuards : NULL, s.freshVars, 
-            m.msg, refinableInfos, liveVars, m.cprotect, balanceCheckingEnabled ? &s.balance : NULL, checkedVarsCache);
-              // NOTE: must be called before balance handling
-              //  because it uses some state of balance handling that will be removed by the call to
-              //  handleBalanceForNonTerminator, e.g. re protection counter or topsave variable
-            
-          if (restartable && refinableInfos > 0) { clearStates(); return; }
-        }
-        if (balanceCheckingEnabled) {
-          handleBalanceForNonTerminator(in, s.balance, m.gl, counterVarsCache, saveVarsCache, m.msg, refinableInfos);
-          if (restartable && refinableInfos > 0) { clearStates(); return; }
-        }
- 
-        if (intGuardsEnabled) {
-          intGuardsChecker.handleForNonTerminator(in, s.intGuards);
-          if (restartable && refinableInfos > 0) { clearStates(); return; }
-          if (balanceCheckingEnabled) {
-            handleUnprotectWithIntGuard(in, s, m.gl, intGuardsChecker, m.msg, refinableInfos);
-            if (restartable && refinableInfos > 0) { clearStates(); return; }
+            if (INT_GUARDS && (handlers & IH_INT_GUARDS)) {
+              s.forEachIntGuards([this, in](IntGuardsTy& g) { intGuardsChecker.handleForNonTerminator(in, g); });
+              if (restartable && refinableInfos > 0) { States::clear(); return true; }
+            }
+            if (INT_GUARDS && BALANCE && (handlers & IH_UNPROTECT_WITH_INT_GUARD)) {
+              handleUnprotectWithIntGuard(in, *balanceOf(s), s.intGuards, m.gl, intGuardsChecker, m.msg, refinableInfos);
+              if (restartable && refinableInfos > 0) { States::clear(); return true; }
+            }
+            if (SEXP_GUARDS && (handlers & IH_SEXP_GUARDS)) {
+              sexpGuardsChecker.handleForNonTerminator(in, s.sexpGuards, ei->storedFunId);
+              if (restartable && refinableInfos > 0) { States::clear(); return true; }
+            }
+          }
+          if (VERIFY_EVENTS) {
+            for(BasicBlock::iterator ve = (*bi)->end(); vi != ve; ++vi) {
+              verifySkippedHandlers<INT_GUARDS, SEXP_GUARDS, BALANCE, FRESH_VARS>(&*vi, 0, s);
+            }
           }
         }
-        if (sexpGuardsEnabled) {
-          sexpGuardsChecker.handleForNonTerminator(in, s.sexpGuards);
-          if (restartable && refinableInfos > 0) { clearStates(); return; }
-        }
-      }
-      
-      TerminatorInst *t = s.bb->getTerminator();
 
-      if (freshVarsCheckingEnabled) {
-        handleFreshVarsForTerminator(t, s.freshVars, liveVars); // does nothing anyway
-      }
+        if (FRESH_VARS) {
+          handleFreshVarsForTerminator(t, *freshVarsOf(s), liveVars); // does nothing anyway
+        }
 
-      if (balanceCheckingEnabled && handleBalanceForTerminator(t, s, m.gl, counterVarsCache, m.msg, refinableInfos)) {
-        // ignore successors in case important errors were already found, and hence further
-        // errors found will just confuse the user
-        continue;
-      }
+        if (BALANCE && handleBalanceForTerminator(t, s, m.gl, vars, m.msg, refinableInfos)) {
+          // ignore successors in case important errors were already found, and hence further
+          // errors found will just confuse the user
+          continue;
+        }
 
-      if (sexpGuardsEnabled && sexpGuardsChecker.handleForTerminator(t, s)) {
-        continue;
-      }
+        if (SEXP_GUARDS && sexpGuardsChecker.handleForTerminator(t, s)) {
+          continue;
+        }
 
-        // int guards have to be after balance, so that "if (nprotect) UNPROTECT(nprotect)"
-        // is handled in preference of int guard
-      if (intGuardsEnabled && intGuardsChecker.handleForTerminator(t, s)) {
-        continue;
-      }
+          // int guards have to be after balance, so that "if (nprotect) UNPROTECT(nprotect)"
+          // is handled in preference of int guard
+        if (INT_GUARDS && intGuardsChecker.handleForTerminator(t, s)) {
+          continue;
+        }
       
-      // add conservatively all cfg successors
-      for(int i = 0, nsucc = t->getNumSuccessors(); i < nsucc; i++) {
-        BasicBlock *succ = t->getSuccessor(i);
-        {
-          StateTy* state = s.clone(succ);
-          if (state->add()) {
-            m.msg.trace("added (conservatively) successor of", t);
+        // add conservatively all cfg successors
+        for(int i = 0, nsucc = t->getNumSuccessors(); i < nsucc; i++) {
+          BasicBlock *succ = t->getSuccessor(i);
+          {
+            bool last = i == nsucc - 1 && variants.empty(); // s is not needed after the last successor
+            State* state = last ? s.moveTo(succ) : s.clone(succ);
+            if (state->add()) {
+              m.msg.trace("added (conservatively) successor of", t);
+            }
           }
         }
-      }
+      } while(nextVariant(s, variants));
+    }
+    States::clear();
+    return true;
+  }
+
+  template <bool BALANCE, bool FRESH_VARS> bool checkFunction(bool intGuardsEnabled, bool sexpGuardsEnabled, JoinModeTy joinMode, unsigned& refinableInfos) {
+    if (intGuardsEnabled && sexpGuardsEnabled) {
+      return checkFunction<true, true, BALANCE, FRESH_VARS>(joinMode, refinableInfos);
+    } else if (intGuardsEnabled) {
+      return checkFunction<true, false, BALANCE, FRESH_VARS>(joinMode, refinableInfos);
+    } else if (sexpGuardsEnabled) {
+      return checkFunction<false, true, BALANCE, FRESH_VARS>(joinMode, refinableInfos);
+    } else {
+      return checkFunction<false, false, BALANCE, FRESH_VARS>(joinMode, refinableInfos);
+    }
+  }
+
+  bool checkFunction(bool intGuardsEnabled, bool sexpGuardsEnabled, bool balanceCheckingEnabled, bool freshVarsCheckingEnabled, JoinModeTy joinMode,
+      unsigned& refinableInfos) {
+    if (balanceCheckingEnabled && freshVarsCheckingEnabled) {
+      return checkFunction<true, true>(intGuardsEnabled, sexpGuardsEnabled, joinMode, refinableInfos);
+    } else if (balanceCheckingEnabled) {
+      return checkFunction<true, false>(intGuardsEnabled, sexpGuardsEnabled, joinMode, refinableInfos);
+    } else {
+      myassert(freshVarsCheckingEnabled);
+      return checkFunction<false, true>(intGuardsEnabled, sexpGuardsEnabled, joinMode, refinableInfos);
     }
   }
   
   public:
-    FunctionChecker(Function *fun, ModuleCheckingStateTy& moduleState): 
-        fun(fun), saveVarsCache(), counterVarsCache(), checkedVarsCache(), intGuardsChecker(&moduleState.msg), 
+    FunctionChecker(Function *fun, VarTableTy& vars, ModuleCheckingStateTy& moduleState): 
+        fun(fun), vars(vars), blockEvents(), quietBlocks(), cfg(), intGuardsChecker(&moduleState.msg), 
         /* TODO: we would need "sure" allocators here instead of possible allocators! */
         sexpGuardsChecker(&moduleState.msg, &moduleState.gl, 
-          USE_ALLOCATOR_DETECTION ? moduleState.cm.getContextSensitivePossibleAllocators() : NULL, moduleState.cm.getSymbolsMap(), NULL, moduleState.cm.getVrfState(), &moduleState.cm),
-        errorBasicBlocks(), m(moduleState) {
+          USE_ALLOCATOR_DETECTION ? moduleState.cm.getContextSensitivePossibleAllocatorsBits() : NULL, moduleState.cm.getSymbolsMap(), NULL, moduleState.cm.getVrfState(), &moduleState.cm),
+        errorBasicBlocks(), maxStates(MAX_STATES), m(moduleState) {
         
       findErrorBasicBlocks(fun, &m.errorFunctions, errorBasicBlocks);
       liveVars = findLiveVariables(fun);
+      intGuardsChecker.reset(fun, vars);
+      sexpGuardsChecker.reset(fun, vars);
+      findBlockEvents(fun, m.gl, vars, m.cm, blockEvents);
+      findQuietBlocks(fun, vars, blockEvents, quietBlocks);
+      cfg.reset(fun, errorBasicBlocks, [this](BasicBlock *bb) { return !blockEvents.at(bb).empty(); });
     }  
   
+    // a rough estimate of the number of states when checking the function
+    //   with the given guards: int guards may double the states, SEXP guards
+    //   triple them, and protection counters may take a value per iteration
+    double estimateStates(bool intGuards, bool sexpGuards) const {
+      double estimate = (double) fun->size() * (1 + cfg.getNLoopHeaders()) * (1 + cfg.getLoopDepth() * vars.count(VF_COUNTER));
+      if (intGuards) {
+        estimate *= std::pow(2.0, vars.count(VF_INT_GUARD));
+      }
+      if (sexpGuards) {
+        estimate *= std::pow(3.0, vars.count(VF_SEXP_GUARD));
+      }
+      return estimate;
+    }
+
+    // picks the guards and join mode to start with (see PREDICT_PRECISION)
+    //   returns true when the function is expected to have too many states
+    bool predictPrecision(const std::string& key, bool& intGuards, bool& sexpGuards, JoinModeTy& joinMode) const {
+
+      auto oi = checkingOutcomes.find(key);
+      if (oi != checkingOutcomes.end()) {
+        predictionStats.nFromHistory++;
+        intGuards = oi->second.intGuards && !avoidIntGuards();
+        sexpGuards = oi->second.sexpGuards && !avoidSEXPGuards();
+        joinMode = JOIN_ON_TOO_MANY_STATES ? oi->second.joinMode : JM_NONE;
+        return false; // already joining when it had too many states
+      }
+
+      unsigned nIntGuards = vars.count(VF_INT_GUARD);
+      unsigned nSEXPGuards = vars.count(VF_SEXP_GUARD);
+      intGuards = nIntGuards > 0 && nIntGuards <= PREDICT_MAX_INT_GUARDS && !avoidIntGuards();
+      sexpGuards = nSEXPGuards > 0 && nSEXPGuards <= PREDICT_MAX_SEXP_GUARDS && !avoidSEXPGuards();
+      joinMode = JM_NONE;
+      if (estimateStates(intGuards, sexpGuards) <= MAX_STATES) {
+        return false;
+      }
+      // the guards could be enabled later on a restart
+      intGuards = false;
+      sexpGuards = false;
+      return estimateStates(false, false) > MAX_STATES;
+    }
+
     // handles restarts
     void checkFunction(bool balanceCheckingEnabled, bool freshVarsCheckingEnabled, std::string checksName) {
 
-      m.msg.newFunction(fun, checksName);
+      std::string key = funName(fun) + checksName;
       bool intGuardsEnabled = false;
       bool sexpGuardsEnabled = false;
+      JoinModeTy joinMode = JM_NONE;
+      bool predictedBlowup = PREDICT_PRECISION && predictPrecision(key, intGuardsEnabled, sexpGuardsEnabled, joinMode);
+      bool startIntGuards = intGuardsEnabled;
+      bool startSEXPGuards = sexpGuardsEnabled;
+      bool ranOutOfStates = false;
       unsigned refinableInfos;
+
+      // with a predicted blowup, run out of states early and join
+      maxStates = predictedBlowup ? MAX_STATES / PREDICT_BLOWUP_BUDGET_DIVISOR : MAX_STATES;
+      m.msg.newFunction(fun, joinMode == JM_NONE ? checksName : checksName + JOINED_STATES_TAG);
     
       for(;;) {
-        checkFunction(intGuardsEnabled, sexpGuardsEnabled, balanceCheckingEnabled, freshVarsCheckingEnabled, refinableInfos);
+        if (!checkFunction(intGuardsEnabled, sexpGuardsEnabled, balanceCheckingEnabled, freshVarsCheckingEnabled, joinMode, refinableInfos)) {
+          ranOutOfStates = true;
+          maxStates = MAX_STATES;
+          if (!JOIN_ON_TOO_MANY_STATES || joinMode == JM_ALL) {
+            errs() << "ERROR: too many states (abstraction error?) in function " << funName(fun) << "\n";
+            break;
+          }
+          // retry joining states (keeping the guards that were enabled)
+          joinMode = (joinMode == JM_NONE && JOIN_AT_REGIONS_FIRST) ? JM_REGIONS : JM_ALL;
+          errs() << "NOTE: too many states in function " << funName(fun) << ", checking again with joined states" <<
+            (joinMode == JM_REGIONS ? " at region entries" : "") << "\n";
+          m.msg.clear(checksName + JOINED_STATES_TAG);
+          continue;
+        }
     
-        bool restartable = (!intGuardsEnabled && !avoidIntGuardsFor(fun)) || (!sexpGuardsEnabled && !avoidSEXPGuardsFor(fun));
+        bool restartable = joinMode == JM_NONE && ((!intGuardsEnabled && !avoidIntGuards()) || (!sexpGuardsEnabled && !avoidSEXPGuards()));
         if (restartable && refinableInfos>0) {
           // retry with more precise checking
           m.msg.clear();
-          if (!intGuardsEnabled && !avoidIntGuardsFor(fun)) {
+          if (!intGuardsEnabled && !avoidIntGuards()) {
             intGuardsEnabled = true;
-          } else if (!sexpGuardsEnabled && !avoidSEXPGuardsFor(fun)) {
+          } else if (!sexpGuardsEnabled && !avoidSEXPGuards()) {
             sexpGuardsEnabled = true;
           }
         } else {
           break;
         }
       }
+
+      if (PREDICT_PRECISION) {
+        if (intGuardsEnabled == startIntGuards && sexpGuardsEnabled == startSEXPGuards) {
+          predictionStats.nPrecisionSufficed++;
+        } else {
+          predictionStats.nPrecisionRefined++;
+        }
+        if (predictedBlowup) {
+          predictionStats.nBlowupsPredicted++;
+          if (ranOutOfStates) {
+            predictionStats.nBlowupsConfirmed++;
+          }
+        } else if (ranOutOfStates) {
+          predictionStats.nBlowupsMissed++;
+        }
+      }
+      checkingOutcomes[key] = {intGuardsEnabled, sexpGuardsEnabled, joinMode};
     }
 };
 
@@ -523,7 +1723,8 @@ int main(int argc, char* argv[])
   findErrorFunctions(m, errorFunctions);
 
   FunctionsSetTy possibleAllocators;
-  findPossibleAllocators(m, possibleAllocators);
+  PossiblyReturnedVarsMapTy possiblyReturnedVars;
+  findPossibleAllocators(m, possibleAllocators, possiblyReturnedVars);
 
   FunctionsSetTy allocatingFunctions;
   findAllocatingFunctions(m, allocatingFunctions);
@@ -531,13 +1732,20 @@ int main(int argc, char* argv[])
   SymbolsMapTy symbolsMap;
   findSymbols(m, &symbolsMap);
   
-  CalledModuleTy cm(m, &symbolsMap, &errorFunctions, &gl, &possibleAllocators, &allocatingFunctions);
-  CProtectInfo cprotect = findCalleeProtectFunctions(m, *cm.getContextSensitiveAllocatingFunctions());
+  CalledModuleTy cm(m, &symbolsMap, &errorFunctions, &gl, &possibleAllocators, &allocatingFunctions, &possiblyReturnedVars);
+  CProtectInfo cprotect = findCalleeProtectFunctions(m, *cm.getContextSensitiveAllocatingFunctions(), cm.getFunctionIds());
   
   ModuleCheckingStateTy mstate(possibleAllocators, allocatingFunctions, errorFunctions, gl, msg, cm, cprotect); 
     // FIXME: perhaps get rid of ModuleCheckingState now that we have CalledModule
 
+  const char* historyFile = getenv(PRECISION_HISTORY_VARIABLE);
+  if (historyFile && *historyFile) {
+    readCheckingOutcomes(historyFile, checkingOutcomes);
+  }
+
   unsigned nAnalyzedFunctions = 0;
+  unsigned nTriviallyCleanFunctions = 0;
+  unsigned nScreenedFunctions = 0;
   for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
     Function *fun = *FI;
 
@@ -554,7 +1762,24 @@ int main(int argc, char* argv[])
     }
     
     nAnalyzedFunctions++;
-    FunctionChecker fchk(fun, mstate);
+    if (PREFILTER && isTriviallyCleanForBalance(functionTraits(fun, gl, possibleAllocators, &allocatingFunctions))) {
+      nTriviallyCleanFunctions++;
+      continue;
+    }
+    VarTableTy vars;
+    vars.reset(fun, gl);
+    bool screened = false;
+    if (TRIAGE) {
+      screened = screenFunction(fun, gl, vars, possibleAllocators, allocatingFunctions, errorFunctions);
+      if (screened) {
+        nScreenedFunctions++;
+        if (!VERIFY_TRIAGE) {
+          continue;
+        }
+      }
+    }
+    unsigned long nKept = msg.getNKept();
+    FunctionChecker fchk(fun, vars, mstate);
 
     if (SEPARATE_CHECKING) {
         // FIXME: it would make more sense to only print prefixes [BP] and [UP] with join checking
@@ -563,12 +1788,46 @@ int main(int argc, char* argv[])
     } else {
       fchk.checkFunction(true, true, "");  
     }
+    if (screened) {
+      msg.flush(); // count the messages kept after restarts
+      if (msg.getNKept() != nKept) {
+        errs() << "ERROR: function " << funName(fun) << " skipped by the screen has messages\n";
+      }
+    }
   }
+  size_t calledTablesMemory = cm.tablesMemoryUsage();
+  size_t msgTablesMemory = msg.tablesMemoryUsage();
   msg.flush();
-  clearStates();
   delete m;
 
   outs().flush();
-  errs() << "Analyzed " << nAnalyzedFunctions << " functions, traversed " << totalStates << " states.\n";
+  errs() << "Analyzed " << nAnalyzedFunctions << " functions, traversed " << totalStates << " states";
+  if (MERGE_COND_MSGS) {
+    errs() << ", merged " << totalMergedStates << " states";
+  }
+  errs() << ".\n";
+  errs() << "Intern tables use " << ((calledTablesMemory + msgTablesMemory + symbolsMemoryUsage()) >> 10) << " KB (called functions " <<
+    (calledTablesMemory >> 10) << " KB, messages " << (msgTablesMemory >> 10) << " KB, symbols " << (symbolsMemoryUsage() >> 10) << " KB).\n";
+  if (SYMBOLIC_INT_GUARDS) {
+    errs() << "Used symbolic int guards in " << totalSymbolicChecks << " function checks, split " << totalSplitStates << " states into " <<
+      totalSplitValuations << " valuations.\n";
+  }
+  if (PREFILTER && nAnalyzedFunctions) {
+    errs() << "Skipped " << nTriviallyCleanFunctions << " of " << nAnalyzedFunctions << " functions (" <<
+      (100 * nTriviallyCleanFunctions / nAnalyzedFunctions) << "%) as trivially clean.\n";
+  }
+  if (TRIAGE && nAnalyzedFunctions) {
+    errs() << "Skipped " << nScreenedFunctions << " of " << nAnalyzedFunctions << " functions (" <<
+      (100 * nScreenedFunctions / nAnalyzedFunctions) << "%) proven clean by the screen" << (VERIFY_TRIAGE ? " (checked anyway)" : "") << ".\n";
+  }
+  if (PREDICT_PRECISION) {
+    const PredictionStatsTy& ps = predictionStats;
+    errs() << "Predicted precision for " << (ps.nPrecisionSufficed + ps.nPrecisionRefined) << " checks (" << ps.nFromHistory << " from history): " <<
+      ps.nPrecisionSufficed << " kept, " << ps.nPrecisionRefined << " refined; predicted too many states for " << ps.nBlowupsPredicted <<
+      " (" << ps.nBlowupsConfirmed << " confirmed), missed " << ps.nBlowupsMissed << ".\n";
+  }
+  if (historyFile && *historyFile) {
+    writeCheckingOutcomes(historyFile, checkingOutcomes);
+  }
   return 0;
 }
@@ -1,5 +1,6 @@
 
 #include "callocators.h"
+#include "compactcfg.h"
 #include "errors.h"
 #include "guards.h"
 #include "symbols.h"
@@ -8,7 +9,10 @@
 #include "table.h"
 #include "exceptions.h"
 #include "patterns.h"
+#include "vartable.h"
+#include "vectors.h"
 
+#include <algorithm>
 #include <map>
 #include <stack>
 #include <unordered_set>
@@ -66,7 +70,7 @@ std::string CalledFunctionTy::getNameSuffix() const {
       suff += ",";
     }
     if (a && a->isSymbol()) {
-      suff += "S:" + static_cast<const SymbolArgInfoTy*>(a)->symbolName;
+      suff += "S:" + static_cast<const SymbolArgInfoTy*>(a)->getSymbolName();
       nKnown++;
     } else if (a && a->isVector()) {
       suff += "V";
@@ -109,7 +113,7 @@ size_t ArgInfosVectorTy_hash::operator()(const ArgInfosVectorTy& t) const {
   for(ArgInfosVectorTy::const_iterator ai = t.begin(), ae = t.end(); ai != ae; ++ai) {
     const ArgInfoTy *a = *ai;
     if (a && a->isSymbol()) {
-      hash_combine(res, static_cast<const SymbolArgInfoTy*>(a)->symbolName);
+      hash_combine(res, static_cast<const SymbolArgInfoTy*>(a)->symbol);
       cntSym++;
     } else if (a && a->isVector()) {
       hash_combine(res, true);
@@ -124,7 +128,7 @@ size_t ArgInfosVectorTy_hash::operator()(const ArgInfosVectorTy& t) const {
 const CalledFunctionTy* CalledModuleTy::getCalledFunction(Function *f) {
   size_t nargs = f->arg_size();
   ArgInfosVectorTy argInfos(nargs, NULL);
-  CalledFunctionTy calledFunction(f, intern(argInfos), this);
+  CalledFunctionTy calledFunction(f, intern(argInfos), this, getFunctionId(f));
   return intern(calledFunction);
 }
 
@@ -163,10 +167,10 @@ const CalledFunctionTy* CalledModuleTy::getCalledFunction(Value *inst, SEXPGuard
       if (sexpGuards && sexpGuardsChecker && AllocaInst::classof(src)) {
         AllocaInst *var = cast<AllocaInst>(src);
           
-        std::string symbolName;
-        SEXPGuardState gs = sexpGuardsChecker->getGuardState(*sexpGuards, var, symbolName);
+        SymbolIdTy symbol;
+        SEXPGuardState gs = sexpGuardsChecker->getGuardState(*sexpGuards, var, symbol);
         if (gs == SGS_SYMBOL) {
-          argInfo[i] = SymbolArgInfoTy::create(symbolName);
+          argInfo[i] = SymbolArgInfoTy::create(symbol);
           continue;
         }
         if (gs == SGS_VECTOR) {
@@ -175,9 +179,9 @@ const CalledFunctionTy* CalledModuleTy::getCalledFunction(Value *inst, SEXPGuard
         }
       }
     }
-    std::string symbolName;  // install("X")
-    if (isInstallConstantCall(arg, symbolName)) {
-      argInfo[i] = SymbolArgInfoTy::create(symbolName);
+    SymbolIdTy symbol;  // install("X")
+    if (isInstallConstantCall(arg, symbol)) {
+      argInfo[i] = SymbolArgInfoTy::create(symbol);
       continue;
     }
     if (isVectorProducingCall(arg, this, sexpGuardsChecker, sexpGuards)) {
@@ -187,7 +191,7 @@ const CalledFunctionTy* CalledModuleTy::getCalledFunction(Value *inst, SEXPGuard
     // not a symbol, leave argInfo as NULL
   }
       
-  CalledFunctionTy calledFunction(fun, intern(argInfo), this);
+  CalledFunctionTy calledFunction(fun, intern(argInfo), this, getFunctionId(fun));
   const CalledFunctionTy* cf = intern(calledFunction);
   
   if (registerCallSite) {
@@ -206,9 +210,12 @@ const CalledFunctionTy* CalledModuleTy::getCalledFunction(Value *inst, SEXPGuard
 }
 
 CalledModuleTy::CalledModuleTy(Module *m, SymbolsMapTy *symbolsMap, FunctionsSetTy* errorFunctions, GlobalsTy* globals, 
-  FunctionsSetTy* possibleAllocators, FunctionsSetTy* allocatingFunctions):
+  FunctionsSetTy* possibleAllocators, FunctionsSetTy* allocatingFunctions, PossiblyReturnedVarsMapTy* possiblyReturnedVars):
   
-  m(m), symbolsMap(symbolsMap), errorFunctions(errorFunctions), globals(globals), possibleAllocators(possibleAllocators), allocatingFunctions(allocatingFunctions),
+  m(m), functionIds(m), symbolsMap(symbolsMap), errorFunctions(errorFunctions), globals(globals), possibleAllocators(possibleAllocators), allocatingFunctions(allocatingFunctions),
+  possiblyReturnedVars(possiblyReturnedVars),
+  possibleAllocatorsBits(functionIds.bits(*possibleAllocators)), allocatingFunctionsBits(functionIds.bits(*allocatingFunctions)),
+  contextSensitivePossibleAllocatorsBits(), possibleCAllocatorsBits(), allocatingCFunctionsBits(),
   callSiteTargets(), vrfState(NULL), gcFunction(getCalledFunction(getGCFunction(m)))  {
 
   for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
@@ -256,16 +263,18 @@ CalledModuleTy* CalledModuleTy::create(Module *m) {
   GlobalsTy *globals = new GlobalsTy(m);
   
   FunctionsSetTy *possibleAllocators = new FunctionsSetTy();
-  findPossibleAllocators(m, *possibleAllocators);
+  PossiblyReturnedVarsMapTy *possiblyReturnedVars = new PossiblyReturnedVarsMapTy();
+  findPossibleAllocators(m, *possibleAllocators, *possiblyReturnedVars);
 
   FunctionsSetTy *allocatingFunctions = new FunctionsSetTy();
   findAllocatingFunctions(m, *allocatingFunctions);
 
-  return new CalledModuleTy(m, symbolsMap, errorFunctions, globals, possibleAllocators, allocatingFunctions);
+  return new CalledModuleTy(m, symbolsMap, errorFunctions, globals, possibleAllocators, allocatingFunctions, possiblyReturnedVars);
 }
 
 void CalledModuleTy::release(CalledModuleTy *cm) {
   delete cm->getAllocatingFunctions();
+  delete cm->getPossiblyReturnedVars();
   delete cm->getPossibleAllocators();
   delete cm->getGlobals();
   delete cm->getErrorFunctions();
@@ -324,6 +333,7 @@ static VarOriginsTy unpackVarOrigins(const InternedVarOriginsTy& internedOrigins
 }
 
 static CalledFunctionsOSTableTy osTable; // interned ordered sets
+static size_t osTablePeakMemory = 0; // before clearing
 
 static InternedVarOriginsTy packVarOrigins(const VarOriginsTy& varOrigins) {
 
@@ -345,8 +355,6 @@ struct CAllocStateTy : public StateWithGuardsTy {
   CAllocStateTy(const CAllocPackedStateTy& ps, IntGuardsChecker& intGuardsChecker, SEXPGuardsChecker& sexpGuardsChecker):
     CAllocStateTy(ps.bb, intGuardsChecker.unpack(ps.intGuards), sexpGuardsChecker.unpack(ps.sexpGuards), *ps.called, unpackVarOrigins(ps.varOrigins)) {};
 
-  CAllocStateTy(BasicBlock *bb): StateBaseTy(bb), StateWithGuardsTy(bb), called(), varOrigins() {};
-
   CAllocStateTy(BasicBlock *bb, const IntGuardsTy& intGuards, const SEXPGuardsTy& sexpGuards, const CalledFunctionsOrderedSetTy& called, const VarOriginsTy& varOrigins):
     StateBaseTy(bb), StateWithGuardsTy(bb, intGuards, sexpGuards), called(called), varOrigins(varOrigins) {};
       
@@ -388,11 +396,13 @@ struct CAllocStateTy : public StateWithGuardsTy {
 CAllocPackedStateTy CAllocPackedStateTy::create(CAllocStateTy& us, IntGuardsChecker& intGuardsChecker, SEXPGuardsChecker& sexpGuardsChecker) {
 
   InternedVarOriginsTy internedOrigins = packVarOrigins(us.varOrigins);
+  PackedIntGuardsTy intGuards = intGuardsChecker.pack(us.intGuards);
+  PackedSEXPGuardsTy sexpGuards = sexpGuardsChecker.pack(us.sexpGuards);
    
   size_t res = 0;
   hash_combine(res, us.bb);
-  intGuardsChecker.hash(res, us.intGuards);
-  sexpGuardsChecker.hash(res, us.sexpGuards);
+  us.intGuards.hash(res); // incremental, a function of the guard states, so consistent with comparison in packed form
+  us.sexpGuards.hash(res);
     
   hash_combine(res, internedOrigins.size());
   for(InternedVarOriginsTy::const_iterator oi = internedOrigins.begin(), oe = internedOrigins.end(); oi != oe; ++oi) {
@@ -401,7 +411,7 @@ CAllocPackedStateTy CAllocPackedStateTy::create(CAllocStateTy& us, IntGuardsChec
     hash_combine(res, (const void *)srcs); // interned
   } // ordered map
     
-  return CAllocPackedStateTy(res, us.bb, intGuardsChecker.pack(us.intGuards), sexpGuardsChecker.pack(us.sexpGuards), internedOrigins, osTable.intern(us.called));
+  return CAllocPackedStateTy(res, us.bb, intGuards, sexpGuards, internedOrigins, osTable.intern(us.called));
 }
   
 // the hashcode is cached at the time of first hashing
@@ -428,10 +438,18 @@ static DoneSetTy doneSet;   // FIXME: avoid these "globals"
 
 static IntGuardsChecker* intGuardsChecker; // FIXME: avoid these "globals"
 static SEXPGuardsChecker* sexpGuardsChecker; // FIXME: avoid these "globals"
+static CompactCFGTy* functionCFG; // FIXME: avoid these "globals"
 
 
 bool CAllocStateTy::add() {
 
+  bb = functionCFG->node(bb);
+  if (!bb) { // on error path
+    delete this; // NOTE: state suicide
+    return false;
+  }
+  intGuardsChecker->forgetDeadGuards(bb, intGuards);
+  sexpGuardsChecker->forgetDeadGuards(bb, sexpGuards);
   CAllocPackedStateTy ps = CAllocPackedStateTy::create(*this, *intGuardsChecker, *sexpGuardsChecker);
   delete this; // NOTE: state suicide
   auto sinsert = doneSet.insert(ps);
@@ -449,9 +467,25 @@ static void clearStates() { // FIXME: avoid copy paste (vs. bcheck)
   doneSet.clear();
   WorkListTy empty;
   std::swap(workList, empty);
+  osTablePeakMemory = std::max(osTablePeakMemory, osTable.memoryUsage());
   osTable.clear();
 }
 
+// does the block have instructions the explorer acts on
+//   (calls, stores, and vector-only operations for the guard checkers)
+
+static bool isRelevantBlock(BasicBlock *bb) {
+
+  for(BasicBlock::iterator ini = bb->begin(), ine = bb->end(); ini != ine; ++ini) {
+    Instruction *in = &*ini;
+    AllocaInst *vvar;
+    if (StoreInst::classof(in) || CallSite(in) || isVectorOnlyVarOperation(in, vvar)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenger& msg, 
   CalledFunctionsOrderedSetTy& called, CalledFunctionsOrderedSetTy& wrapped) {
 
@@ -462,13 +496,13 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
   }
   CalledModuleTy *cm = f->module;
     
-  VarBoolCacheTy sexpGuardVarsCache;
+  VarTableTy vars;
+  vars.reset(f->fun, *cm->getGlobals());
 
   BasicBlocksSetTy errorBasicBlocks;
   findErrorBasicBlocks(f->fun, cm->getErrorFunctions(), errorBasicBlocks); // FIXME: this could be remembered in CalledFunction
     
-  VarsSetTy possiblyReturnedVars; 
-  findPossiblyReturnedVariables(f->fun, possiblyReturnedVars); // to restrict origin tracking
+  const VarsSetTy& possiblyReturnedVars = findPossiblyReturnedVariables(f->fun, *cm->getPossiblyReturnedVars()); // to restrict origin tracking
     
   bool trackOrigins = isSEXP(f->fun->getReturnType());
     
@@ -489,16 +523,21 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
   }
     
   clearStates();
+  functionCFG = new CompactCFGTy();
+  functionCFG->reset(f->fun, errorBasicBlocks, isRelevantBlock);
   
   msg.newFunction(f->fun, " - " + funName(f));
   intGuardsChecker = new IntGuardsChecker(&msg);
   sexpGuardsChecker = new SEXPGuardsChecker(&msg, cm->getGlobals(), NULL /* possible allocators */, cm->getSymbolsMap(), f->argInfo, cm->getVrfState(), cm);
+  intGuardsChecker->reset(f->fun, vars);
+  sexpGuardsChecker->reset(f->fun, vars);
   
   bool intGuardsEnabled = !avoidIntGuardsFor(f);
   bool sexpGuardsEnabled = !avoidSEXPGuardsFor(f);
   
   {
-    CAllocStateTy* initState = new CAllocStateTy(&f->fun->getEntryBlock());
+    CAllocStateTy* initState = new CAllocStateTy(&f->fun->getEntryBlock(), intGuardsChecker->emptyGuards(), sexpGuardsChecker->emptyGuards(),
+      CalledFunctionsOrderedSetTy(), VarOriginsTy());
     initState->add();
   }
   
@@ -515,16 +554,12 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
       continue;
     }      
 
-    if (errorBasicBlocks.find(s.bb) != errorBasicBlocks.end()) {
-      msg.debug("ignoring basic block on error path", &*s.bb->begin());
-      continue;
-    }
-      
     if (doneSet.size() > MAX_STATES) {
       errs() << "ERROR: too many states (abstraction error?) in function " << funName(f) << "\n";
       clearStates();
       delete intGuardsChecker;
       delete sexpGuardsChecker;
+      delete functionCFG;
       
       if (called.erase(externalFunctionMarker) > 0) {
         // the functions calls an external function
@@ -533,8 +568,8 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
       }      
         
       // NOTE: some callsites may have already been registered to more specific called functions
-      bool originAllocating = cm->isAllocating(f->fun);
-      bool originAllocator = cm->isPossibleAllocator(f->fun);
+      bool originAllocating = cm->isAllocating(f->funId);
+      bool originAllocator = cm->isPossibleAllocator(f->funId);
         
       if (!originAllocating && !originAllocator) {
         return;
@@ -558,17 +593,16 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
         const CalledFunctionTy *ct = cm->getCalledFunction(in, true);
         if (cs) {
           myassert(ct);
-          Function *t = cs.getCalledFunction();
             // note that this is a heuristic, best-effort approach that is not equivalent to what allocators.cpp do
             //   this heuristic may treat a function as wrapped even when allocators.cpp will not
             //
             // on the other hand, we may discover that a call is in a context that makes it non-allocating/non-allocator
             // it would perhaps be cleaner to re-use the context-insensitive algorithm here
             // or just improve performance so that we don't run out of states in the first place
-          if (originAllocating && cm->isAllocating(t)) {
+          if (originAllocating && cm->isAllocating(ct->funId)) {
             called.insert(ct);
           }
-          if (originAllocator && cm->isPossibleAllocator(t)) {
+          if (originAllocator && cm->isPossibleAllocator(ct->funId)) {
             wrapped.insert(ct);
           }
         }
@@ -576,101 +610,104 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
       return;
     }
       
-    // process a single basic block
+    // process a node of the compacted cfg (a chain of basic blocks)
     // FIXME: phi nodes
       
-    for(BasicBlock::iterator ini = s.bb->begin(), ine = s.bb->end(); ini != ine; ++ini) {
-      Instruction *in = &*ini;
-      msg.trace("visiting", in);
-   
-      if (intGuardsEnabled) {
-        intGuardsChecker->handleForNonTerminator(in, s.intGuards);
-      }
-      if (sexpGuardsEnabled) {
-        sexpGuardsChecker->handleForNonTerminator(in, s.sexpGuards);
-      }
-        
-      // handle stores
-      if (trackOrigins && StoreInst::classof(in)) {
-        StoreInst *st = cast<StoreInst>(in);
+    const BasicBlocksVectorTy& chain = functionCFG->blocks(s.bb);
+    for(BasicBlocksVectorTy::const_iterator bi = chain.begin(), be = chain.end(); bi != be; ++bi) {
+      for(BasicBlock::iterator ini = (*bi)->begin(), ine = (*bi)->end(); ini != ine; ++ini) {
+        Instruction *in = &*ini;
+        msg.trace("visiting", in);
+     
+        if (intGuardsEnabled) {
+          intGuardsChecker->handleForNonTerminator(in, s.intGuards);
+        }
+        if (sexpGuardsEnabled) {
+          sexpGuardsChecker->handleForNonTerminator(in, s.sexpGuards, FunctionIdsTy::NONE /* no possible allocators here */);
+        }
           
-        if (AllocaInst::classof(st->getPointerOperand())) {
-          AllocaInst *dst = cast<AllocaInst>(st->getPointerOperand());
-          if (possiblyReturnedVars.find(dst) != possiblyReturnedVars.end() && isSEXP(dst)) {
-            
-            // FIXME: should also handle phi nodes here, currently we may miss some allocators
-            if (msg.debug()) msg.debug("dropping origins of " + varName(dst) + " at variable overwrite", in);
-            s.varOrigins.erase(dst);
-            
-            ValuesSetTy vorig = valueOrigins(st->getValueOperand()); // this goes through Phi's and macros like CDR, CAR etc
-            for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
-              Value *v = *vi;
+        // handle stores
+        if (trackOrigins && StoreInst::classof(in)) {
+          StoreInst *st = cast<StoreInst>(in);
             
-              if (AllocaInst* src = dyn_cast<AllocaInst>(v)) {
-                if (isSEXP(src)) {
-                  // copy all var origins of src into dst
-                  if (msg.debug()) msg.debug("propagating origins on assignment of " + varName(src) + " to " + varName(dst), in); 
-                  auto sorig = s.varOrigins.find(src);
-                  if (sorig != s.varOrigins.end()) {
-                    CalledFunctionsOrderedSetTy& srcOrigs = sorig->second;
-                    s.varOrigins.insert({dst, srcOrigs}); // set (copy) origins
+          if (AllocaInst::classof(st->getPointerOperand())) {
+            AllocaInst *dst = cast<AllocaInst>(st->getPointerOperand());
+            if (possiblyReturnedVars.find(dst) != possiblyReturnedVars.end() && vars.isSEXP(dst)) {
+              
+              // FIXME: should also handle phi nodes here, currently we may miss some allocators
+              if (msg.debug()) msg.debug("dropping origins of " + varName(dst) + " at variable overwrite", in);
+              s.varOrigins.erase(dst);
+              
+              ValuesSetTy vorig = valueOrigins(st->getValueOperand()); // this goes through Phi's and macros like CDR, CAR etc
+              for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
+                Value *v = *vi;
+              
+                if (AllocaInst* src = dyn_cast<AllocaInst>(v)) {
+                  if (vars.isSEXP(src)) {
+                    // copy all var origins of src into dst
+                    if (msg.debug()) msg.debug("propagating origins on assignment of " + varName(src) + " to " + varName(dst), in); 
+                    auto sorig = s.varOrigins.find(src);
+                    if (sorig != s.varOrigins.end()) {
+                      CalledFunctionsOrderedSetTy& srcOrigs = sorig->second;
+                      s.varOrigins.insert({dst, srcOrigs}); // set (copy) origins
+                    }
+                    continue;
                   }
-                  continue;
                 }
-              }
-            
-              const CalledFunctionTy *tgt;
-              if (isCallThroughPointer(v)) {
-                // a function called through a pointer may be e.g. a builtin function, and indeed may be an allocator
-                if (msg.debug())
-                  msg.debug("call through a pointer, asserting it may be allocating (marking as call to gc function) - assigned to " + varName(dst), dyn_cast<Instruction>(v));
-                tgt = cm->getCalledGCFunction();
-              } else {
-                tgt = cm->getCalledFunction(st->getValueOperand(), sexpGuardsChecker, &s.sexpGuards, true);
-                if (tgt && !cm->isPossibleAllocator(tgt->fun)) {
-                  tgt = NULL;
+              
+                const CalledFunctionTy *tgt;
+                if (isCallThroughPointer(v)) {
+                  // a function called through a pointer may be e.g. a builtin function, and indeed may be an allocator
+                  if (msg.debug())
+                    msg.debug("call through a pointer, asserting it may be allocating (marking as call to gc function) - assigned to " + varName(dst), dyn_cast<Instruction>(v));
+                  tgt = cm->getCalledGCFunction();
+                } else {
+                  tgt = cm->getCalledFunction(st->getValueOperand(), sexpGuardsChecker, &s.sexpGuards, true);
+                  if (tgt && !cm->isPossibleAllocator(tgt->funId)) {
+                    tgt = NULL;
+                  }
+                }
+                if (tgt) {
+                  // storing a value gotten from a (possibly allocator) function
+                  if (msg.debug()) msg.debug("setting origin " + funName(tgt) + " of " + varName(dst), in); 
+                  CalledFunctionsOrderedSetTy newOrigins;
+                  newOrigins.insert(tgt);
+                  s.varOrigins.insert({dst, newOrigins});
+                  continue;
                 }
-              }
-              if (tgt) {
-                // storing a value gotten from a (possibly allocator) function
-                if (msg.debug()) msg.debug("setting origin " + funName(tgt) + " of " + varName(dst), in); 
-                CalledFunctionsOrderedSetTy newOrigins;
-                newOrigins.insert(tgt);
-                s.varOrigins.insert({dst, newOrigins});
-                continue;
               }
             }
           }
         }
-      }
+          
+        // handle calls
+        const CalledFunctionTy *tgt;
         
-      // handle calls
-      const CalledFunctionTy *tgt;
-      
-      if (isCallThroughPointer(in)) {
-        if (msg.debug()) msg.debug("call through a pointer, using the external function marker", in);
-        tgt = externalFunctionMarker;
-      } else {
-        tgt = cm->getCalledFunction(in, sexpGuardsChecker, &s.sexpGuards, true);
-        if (tgt && !cm->isAllocating(tgt->fun)) {
-          tgt = NULL;
+        if (isCallThroughPointer(in)) {
+          if (msg.debug()) msg.debug("call through a pointer, using the external function marker", in);
+          tgt = externalFunctionMarker;
+        } else {
+          tgt = cm->getCalledFunction(in, sexpGuardsChecker, &s.sexpGuards, true);
+          if (tgt && !cm->isAllocating(tgt->funId)) {
+            tgt = NULL;
+          }
         }
-      }
-      
-      if (tgt) {
-        if (msg.debug()) msg.debug("recording call to " + funName(tgt), in);
-          
-        if (KEEP_CALLED_IN_STATE) {  
-          if (called.find(tgt) == called.end()) { // if we already know the function is called, don't add, save memory
-            s.called.insert(tgt);
+        
+        if (tgt) {
+          if (msg.debug()) msg.debug("recording call to " + funName(tgt), in);
+            
+          if (KEEP_CALLED_IN_STATE) {  
+            if (called.find(tgt) == called.end()) { // if we already know the function is called, don't add, save memory
+              s.called.insert(tgt);
+            }
+          } else {
+            called.insert(tgt);
           }
-        } else {
-          called.insert(tgt);
         }
       }
     }
       
-    TerminatorInst *t = s.bb->getTerminator();
+    TerminatorInst *t = chain.back()->getTerminator(); // the others are unconditional branches
       
     if (ReturnInst::classof(t)) { // handle return statement
 
@@ -686,7 +723,7 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
           Value *v = *vi;
 
           if (AllocaInst *src = dyn_cast<AllocaInst>(v)) {
-            if (isSEXP(src)) {
+            if (vars.isSEXP(src)) {
               auto origins = s.varOrigins.find(src);
               size_t nOrigins = 0;
               if (origins != s.varOrigins.end()) {
@@ -715,7 +752,7 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
             tgt = cm->getCalledGCFunction();
           } else {
             tgt = cm->getCalledFunction(returnOperand, sexpGuardsChecker, &s.sexpGuards, true);
-            if (tgt && !cm->isPossibleAllocator(tgt->fun)) {
+            if (tgt && !cm->isPossibleAllocator(tgt->funId)) {
               tgt = NULL;
             }
           }
@@ -749,6 +786,7 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
   clearStates();
   delete intGuardsChecker;
   delete sexpGuardsChecker;
+  delete functionCFG;
   
   if (trackOrigins && called.find(cm->getCalledGCFunction()) != called.end()) {
     // the GC function is an exception
@@ -838,7 +876,7 @@ void CalledModuleTy::computeCalledAllocators() {
   for(unsigned i = 0; i < getNumberOfCalledFunctions(); i++) {
 
     const CalledFunctionTy *f = getCalledFunction(i);
-    if (!f->fun || !f->fun->size() || !isAllocating(f->fun)) {
+    if (!f->fun || !f->fun->size() || !isAllocating(f->funId)) {
       continue;
     }
     
@@ -862,7 +900,7 @@ void CalledModuleTy::computeCalledAllocators() {
     }
     if (DEBUG) {
       FunctionsSetTy wrappedAllocators;
-      getWrappedAllocators(f->fun, wrappedAllocators, getGCFunction(m));
+      getWrappedAllocators(f->fun, wrappedAllocators, getGCFunction(m), *possiblyReturnedVars);
       if (!wrappedAllocators.empty()) {
         errs() << "\nSimple (possible allocators) wrapped by function " << funName(f) << ":\n";
         for(FunctionsSetTy::iterator fi = wrappedAllocators.begin(), fe = wrappedAllocators.end(); fi != fe; ++fi) {
@@ -927,8 +965,26 @@ void CalledModuleTy::computeCalledAllocators() {
   possibleCAllocators->insert(gcFunction);
   contextSensitiveAllocatingFunctions->insert(gcFunction->fun);
   contextSensitivePossibleAllocators->insert(gcFunction->fun);
+  
+  possibleCAllocatorsBits = calledFunctionsBits(*possibleCAllocators);
+  allocatingCFunctionsBits = calledFunctionsBits(*allocatingCFunctions);
+  contextSensitivePossibleAllocatorsBits = functionIds.bits(*contextSensitivePossibleAllocators);
+}
+
+CalledFunctionsBitsTy CalledModuleTy::calledFunctionsBits(const CalledFunctionsSetTy& functions) {
+  CalledFunctionsBitsTy res(getNumberOfCalledFunctions(), false);
+  for(CalledFunctionsSetTy::const_iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
+    const CalledFunctionTy *f = *fi;
+    res[f->idx] = true;
+  }
+  return res;
 }
 
 std::string funName(const CalledFunctionTy *cf) {
   return funName(cf->fun) + cf->getNameSuffix();  
 }
+
+size_t CalledModuleTy::tablesMemoryUsage() const {
+  return calledFunctionsTable.memoryUsage() + argInfoVectorsTable.memoryUsage() + SymbolArgInfoTy::table.memoryUsage() +
+    std::max(osTablePeakMemory, osTable.memoryUsage());
+}
@@ -24,7 +24,7 @@ using namespace llvm;
 
 struct ArgInfoTy {
 
-  virtual bool isSymbol() const { return false; }; /* this means a specific symbol, defined by its string name */
+  virtual bool isSymbol() const { return false; }; /* this means a specific symbol, defined by its (interned) name */
   virtual bool isVector() const { return false; }; /* this means anything LENGTH could be called on */
   virtual ~ArgInfoTy() = default; // to make the compiler happy :(
 };
@@ -32,28 +32,35 @@ struct ArgInfoTy {
 
 struct SymbolArgInfoTy : public ArgInfoTy {
 
-  const std::string symbolName;
-  SymbolArgInfoTy(const std::string& symbolName) : symbolName(symbolName) {};
+  const SymbolIdTy symbol;
+  SymbolArgInfoTy(SymbolIdTy symbol) : symbol(symbol) {};
   
   virtual bool isSymbol() const { return true; }
+  std::string getSymbolName() const { return ::getSymbolName(symbol); }
   
   struct SymbolArgInfoTy_hash {
     size_t operator()(const SymbolArgInfoTy& t) const {
-      return std::hash<std::string>()(t.symbolName);
+      return t.symbol;
+    }
+    size_t operator()(SymbolIdTy symbol) const {
+      return symbol;
     }
   };
 
   struct SymbolArgInfoTy_equal {
     bool operator() (const SymbolArgInfoTy& lhs, const SymbolArgInfoTy& rhs) const {
-      return lhs.symbolName == rhs.symbolName;
+      return lhs.symbol == rhs.symbol;
+    }
+    bool operator() (const SymbolArgInfoTy& lhs, SymbolIdTy rhs) const {
+      return lhs.symbol == rhs;
     }
   };
 
   typedef InterningTable<SymbolArgInfoTy, SymbolArgInfoTy_hash, SymbolArgInfoTy_equal> SymbolArgInfoTableTy;
   static SymbolArgInfoTableTy table;
   
-  static const SymbolArgInfoTy* create(const std::string& symbolName) {
-    return table.intern(SymbolArgInfoTy(symbolName)); // FIXME: leaks memory  
+  static const SymbolArgInfoTy* create(SymbolIdTy symbol) {
+    return table.internKey(symbol);
   }
 };
 
@@ -81,10 +88,12 @@ struct CalledFunctionTy {
   Function* const fun;
   const ArgInfosVectorTy *argInfo; // NULL element means nothing known about that argument, interned
   CalledModuleTy* const module;
+  const unsigned funId; // module-wide id of fun
   
   unsigned idx; // filled in during interning
 
-  CalledFunctionTy(Function *fun, const ArgInfosVectorTy *argInfo, CalledModuleTy *module): fun(fun), argInfo(argInfo), module(module), idx(UINT_MAX) {};
+  CalledFunctionTy(Function *fun, const ArgInfosVectorTy *argInfo, CalledModuleTy *module, unsigned funId = FunctionIdsTy::NONE):
+    fun(fun), argInfo(argInfo), module(module), funId(funId), idx(UINT_MAX) {};
   std::string getName() const;
   std::string getNameSuffix() const;
   bool hasContext() const;
@@ -103,6 +112,7 @@ typedef std::vector<const CalledFunctionTy*> CalledFunctionsIndexTy;
 
 typedef std::set<const CalledFunctionTy*> CalledFunctionsOrderedSetTy; // for interned functions
 typedef std::unordered_set<const CalledFunctionTy*> CalledFunctionsSetTy; // for interned functions
+typedef std::vector<bool> CalledFunctionsBitsTy; // indexed by CalledFunctionTy::idx
 
 struct ArgInfosVectorTy_hash {
   size_t operator()(const ArgInfosVectorTy& t) const;
@@ -116,9 +126,8 @@ typedef InterningTable<ArgInfosVectorTy, ArgInfosVectorTy_hash> ArgInfoVectorsTa
 
 
   // yikes, need forward type def
-struct SEXPGuardTy;
+struct SEXPGuardsTy;
 class SEXPGuardsChecker;
-typedef std::map<AllocaInst*,SEXPGuardTy> SEXPGuardsTy;
 
 typedef std::map<Value*, CalledFunctionsSetTy> CallSiteTargetsTy;
 
@@ -127,15 +136,25 @@ class CalledModuleTy {
   ArgInfoVectorsTableTy argInfoVectorsTable; // intern table
   
   Module *m;
+  FunctionIdsTy functionIds;
   SymbolsMapTy* symbolsMap;
   FunctionsSetTy* errorFunctions;
   GlobalsTy* globals;
   FunctionsSetTy* possibleAllocators;
   FunctionsSetTy* allocatingFunctions;
+  PossiblyReturnedVarsMapTy* possiblyReturnedVars;
   FunctionsSetTy* contextSensitivePossibleAllocators;
   FunctionsSetTy* contextSensitiveAllocatingFunctions;
   CalledFunctionsSetTy* possibleCAllocators;
   CalledFunctionsSetTy* allocatingCFunctions;
+  
+  // bitset versions of the sets above, for membership tests
+  FunctionsBitsTy possibleAllocatorsBits;
+  FunctionsBitsTy allocatingFunctionsBits;
+  FunctionsBitsTy contextSensitivePossibleAllocatorsBits;
+  CalledFunctionsBitsTy possibleCAllocatorsBits;
+  CalledFunctionsBitsTy allocatingCFunctionsBits;
+  
   CallSiteTargetsTy callSiteTargets; // maps  call instruction -> set of target functions
   VrfStateTy* vrfState; // state for vector returning functions detection
   
@@ -145,10 +164,11 @@ class CalledModuleTy {
     const ArgInfosVectorTy* intern(const ArgInfosVectorTy& argInfos) { return argInfoVectorsTable.intern(argInfos); }
     const CalledFunctionTy* intern(const CalledFunctionTy& calledFunction) { return calledFunctionsTable.intern(calledFunction); }
     void computeCalledAllocators();
+    CalledFunctionsBitsTy calledFunctionsBits(const CalledFunctionsSetTy& functions);
 
   public:
     CalledModuleTy(Module *m, SymbolsMapTy* symbolsMap, FunctionsSetTy* errorFunctions, GlobalsTy* globals,
-      FunctionsSetTy* possibleAllocators, FunctionsSetTy* allocatingFunctions);
+      FunctionsSetTy* possibleAllocators, FunctionsSetTy* allocatingFunctions, PossiblyReturnedVarsMapTy* possiblyReturnedVars);
       
     static CalledModuleTy* create(Module *m);
     static void release(CalledModuleTy *cm);
@@ -165,16 +185,21 @@ class CalledModuleTy {
     
     virtual ~CalledModuleTy();
     
-    bool isAllocating(Function *f) { return allocatingFunctions->find(f) != allocatingFunctions->end(); }
-    bool isPossibleAllocator(Function *f) { return possibleAllocators->find(f) != possibleAllocators->end(); }
-    bool isCAllocating(const CalledFunctionTy *cf) { computeCalledAllocators(); return allocatingCFunctions->find(cf) != allocatingCFunctions->end(); }
-    bool isPossibleCAllocator(const CalledFunctionTy *cf) { computeCalledAllocators(); return possibleCAllocators->find(cf) != possibleCAllocators->end(); }
+    const FunctionIdsTy& getFunctionIds() { return functionIds; }
+    unsigned getFunctionId(const Function *f) { return functionIds.idOf(f); }
+    
+    bool isAllocating(unsigned funId) { return hasFunction(allocatingFunctionsBits, funId); }
+    bool isPossibleAllocator(unsigned funId) { return hasFunction(possibleAllocatorsBits, funId); }
+    bool isCAllocating(const CalledFunctionTy *cf) { computeCalledAllocators(); return hasFunction(allocatingCFunctionsBits, cf->idx); }
+    bool isPossibleCAllocator(const CalledFunctionTy *cf) { computeCalledAllocators(); return hasFunction(possibleCAllocatorsBits, cf->idx); }
     
     FunctionsSetTy* getErrorFunctions() { return errorFunctions; }
     FunctionsSetTy* getPossibleAllocators() { return possibleAllocators; }
     FunctionsSetTy* getAllocatingFunctions() { return allocatingFunctions; }
+    PossiblyReturnedVarsMapTy* getPossiblyReturnedVars() { return possiblyReturnedVars; }
     FunctionsSetTy* getContextSensitiveAllocatingFunctions() { computeCalledAllocators(); return contextSensitiveAllocatingFunctions; }
     FunctionsSetTy* getContextSensitivePossibleAllocators() { computeCalledAllocators(); return contextSensitivePossibleAllocators; }
+    const FunctionsBitsTy* getContextSensitivePossibleAllocatorsBits() { computeCalledAllocators(); return &contextSensitivePossibleAllocatorsBits; }
     GlobalsTy* getGlobals() { return globals; }
     Module* getModule() { return m; }
     const CalledFunctionTy* getCalledGCFunction() { return gcFunction; }
@@ -182,6 +207,7 @@ class CalledModuleTy {
     void computeVectorReturningFunctions() { if (vrfState == NULL) findVectorReturningFunctions(this); }
     VrfStateTy* getVrfState() { computeVectorReturningFunctions(); return vrfState; }
     void setVrfState(VrfStateTy* vrfState) { this->vrfState = vrfState; }
+    size_t tablesMemoryUsage() const; // of the intern tables (of the transient ones at their largest)
 };
 
 std::string funName(const CalledFunctionTy *cf);
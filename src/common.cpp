@@ -386,6 +386,31 @@ GlobalVariable* GlobalsTy::getSpecialVariable(Module *m, std::string name) {
   return v;
 }
 
+FunctionIdsTy::FunctionIdsTy(Module *m) : index() {
+  for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
+    index.indexOf(&*fi);
+  }
+}
+
+unsigned FunctionIdsTy::idOf(const Function *f) const {
+  unsigned id;
+  if (f && index.find(f, id)) {
+    return id;
+  }
+  return NONE;
+}
+
+FunctionsBitsTy FunctionIdsTy::bits(const FunctionsSetTy& functions) const {
+  FunctionsBitsTy res(size(), false);
+  for(FunctionsSetTy::const_iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
+    unsigned id = idOf(*fi);
+    if (id != NONE) {
+      res[id] = true;
+    }
+  }
+  return res;
+}
+
 void myassert_fail (const char *assertion, const char *file, unsigned int line, const char *function) {
   errs() << "RCHK assertion failed: " << assertion << ", in function " << function << " at " << file << ":" << line << "\n";
   abort();
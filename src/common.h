@@ -11,6 +11,10 @@ void myassert_fail (const char *assertion, const char *file, unsigned int line,
   #define myassert(x) (static_cast<void>(0))
 #endif
 
+#include "table.h"
+
+#include <climits>
+#include <cstdint>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
@@ -31,13 +35,6 @@ typedef std::set<Function*> FunctionsOrderedSetTy;
 typedef std::vector<Function*> FunctionsVectorTy;
 typedef std::set<AllocaInst*> VarsOrderedSetTy;
 
-struct VarBoolCacheTy_hash {
-  size_t operator()(const AllocaInst* i) const {
-    return (size_t) i;
-  }
-};
-typedef std::unordered_map<AllocaInst*,bool,VarBoolCacheTy_hash> VarBoolCacheTy;
-
 Module *parseArgsReadIR(int argc, char* argv[], FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector, LLVMContext& context);
 
 std::string demangle(std::string name);
@@ -100,6 +97,29 @@ struct GlobalsTy {
     GlobalVariable *getSpecialVariable(Module *m, std::string name);
 };
 
+// dense module-wide function ids
+//   sets of functions queried on hot paths are kept as bitsets and maps
+//   keyed by function as flat arrays, both indexed by the id
+
+typedef std::vector<bool> FunctionsBitsTy; // indexed by function id
+
+inline bool hasFunction(const FunctionsBitsTy& bits, unsigned id) {
+  return id < bits.size() && bits[id];
+}
+
+class FunctionIdsTy {
+  IndexedTable<Function> index;
+
+  public:
+    static const unsigned NONE = UINT_MAX;
+
+    FunctionIdsTy(Module *m);
+    unsigned idOf(const Function *f) const; // NONE for NULL or a function not in the module
+    Function* at(unsigned id) const { return index.at(id); }
+    size_t size() const { return index.size(); }
+    FunctionsBitsTy bits(const FunctionsSetTy& functions) const;
+};
+
 bool isPointerToStruct(Type* type, std::string name);
 //bool isPointerToUnion(Type* type, std::string name);
 bool isSEXP(AllocaInst *var);
@@ -122,4 +142,12 @@ inline void hash_combine(std::size_t& seed, const T& v) {
   seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
 }
 
+// mixes the bits of a 64-bit word (the splitmix64 finalizer), so that
+//   hashes of similar keys can be combined by XOR
+inline uint64_t mix_bits(uint64_t h) {
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
 #endif
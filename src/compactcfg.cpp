@@ -0,0 +1,147 @@
+
+#include "compactcfg.h"
+
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Instructions.h>
+
+using namespace llvm;
+
+static BasicBlock* unconditionalSuccessor(BasicBlock *bb) {
+
+  BranchInst *br = dyn_cast<BranchInst>(bb->getTerminator());
+  if (!br || br->isConditional()) {
+    return NULL;
+  }
+  return br->getSuccessor(0);
+}
+
+// the block processed right after bb within the same node, if any
+static BasicBlock* chainSuccessor(BasicBlock *bb, const BasicBlocksSetTy& errorBasicBlocks) {
+
+  BasicBlock *succ = unconditionalSuccessor(bb);
+  if (!succ || succ == bb || succ->getSinglePredecessor() != bb || errorBasicBlocks.find(succ) != errorBasicBlocks.end()) {
+    return NULL;
+  }
+  return succ;
+}
+
+void CompactCFGTy::reset(Function *f, const BasicBlocksSetTy& errorBasicBlocks, BasicBlockPredicateTy isRelevant) {
+
+  nodes.clear();
+  chains.clear();
+  ranks.clear();
+  regionEntries.clear();
+  backEdges.clear();
+  loopDepth = 0;
+
+  // strongly connected components come in reverse topological order
+  std::vector<BasicBlocksVectorTy> sccs;
+  for(scc_iterator<Function*> si = scc_begin(f); !si.isAtEnd(); ++si) {
+    sccs.push_back(*si);
+  }
+  nranks = sccs.size();
+  for(unsigned i = 0; i < nranks; i++) {
+    const BasicBlocksVectorTy& scc = sccs[i];
+    for(BasicBlocksVectorTy::const_iterator bi = scc.begin(), be = scc.end(); bi != be; ++bi) {
+      ranks.insert({*bi, nranks - 1 - i});
+    }
+  }
+
+  // fold irrelevant blocks (each block is walked over once)
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    if (nodes.find(bb) != nodes.end()) {
+      continue;
+    }
+    BasicBlocksVectorTy path;
+    BasicBlocksSetTy onPath;
+    BasicBlock *n = bb;
+    BasicBlock *res;
+    for(;;) {
+      auto ni = nodes.find(n);
+      if (ni != nodes.end()) {
+        res = ni->second;
+        break;
+      }
+      if (errorBasicBlocks.find(n) != errorBasicBlocks.end()) {
+        res = NULL;
+        break;
+      }
+      path.push_back(n);
+      onPath.insert(n);
+      BasicBlock *succ = isRelevant(n) ? NULL : unconditionalSuccessor(n);
+      if (!succ || onPath.find(succ) != onPath.end()) { // a cycle of irrelevant blocks is kept as is
+        res = n;
+        break;
+      }
+      n = succ;
+    }
+    for(BasicBlocksVectorTy::iterator pi = path.begin(), pe = path.end(); pi != pe; ++pi) {
+      nodes.insert({*pi, res});
+    }
+  }
+
+  // chains are needed for the entry and for targets of edges leaving a node
+  BasicBlocksVectorTy heads;
+  heads.push_back(node(&f->getEntryBlock()));
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    BasicBlock *next = chainSuccessor(bb, errorBasicBlocks);
+    for(succ_iterator si = succ_begin(bb), se = succ_end(bb); si != se; ++si) {
+      if (*si != next) {
+        heads.push_back(node(*si));
+      }
+    }
+  }
+
+  for(BasicBlocksVectorTy::iterator hi = heads.begin(), he = heads.end(); hi != he; ++hi) {
+    BasicBlock *head = *hi;
+    if (!head || chains.find(head) != chains.end()) {
+      continue;
+    }
+    BasicBlocksVectorTy& chain = chains[head];
+    chain.push_back(head);
+    for(BasicBlock *b = chainSuccessor(head, errorBasicBlocks); b && b != head; b = chainSuccessor(b, errorBasicBlocks)) {
+      chain.push_back(b);
+    }
+  }
+
+  DominatorTree dt(*f);
+  DominatorTreeBase<BasicBlock> pdt(true); // post-dominators
+  pdt.recalculate(*f);
+
+  for(auto ci = chains.begin(), ce = chains.end(); ci != ce; ++ci) {
+    BasicBlock *last = ci->second.back(); // dominated by the head
+    if (last->getTerminator()->getNumSuccessors() < 2) {
+      continue;
+    }
+    DomTreeNode *pn = pdt.getNode(last);
+    if (!pn || !pn->getIDom() || !pn->getIDom()->getBlock()) { // no single exit
+      continue;
+    }
+    if (dt.dominates(last, pn->getIDom()->getBlock())) {
+      regionEntries.insert(ci->first);
+    }
+  }
+
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    for(succ_iterator si = succ_begin(bb), se = succ_end(bb); si != se; ++si) {
+      BasicBlock *n = node(*si);
+      if (n && dt.dominates(n, bb)) {
+        backEdges[n].insert(bb);
+      }
+    }
+  }
+
+  LoopInfo li(dt);
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    unsigned depth = li.getLoopDepth(&*bi);
+    if (depth > loopDepth) {
+      loopDepth = depth;
+    }
+  }
+}
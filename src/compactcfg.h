@@ -0,0 +1,98 @@
+#ifndef RCHK_COMPACTCFG_H
+#define RCHK_COMPACTCFG_H
+
+#include "common.h"
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+
+using namespace llvm;
+
+// a compacted view of the CFG of a function for the path-sensitive checkers
+//
+// states are only created (hashed, deduplicated) at nodes, a node is a
+// chain of basic blocks each ending with an unconditional branch to the
+// next one, which has no other predecessor
+//
+// blocks without relevant instructions that end with an unconditional
+// branch are folded into their successor and edges to blocks on error paths
+// are dropped: node(bb) gives the node to continue at instead of bb, or NULL
+// when the successor is to be ignored
+//
+// the rank of a block is the position of its strongly connected component
+// in a topological order of the condensed cfg, so a block can only reach
+// blocks of the same or higher rank
+//
+// a region entry is a node ending with a branch whose immediate
+// post-dominator it dominates, so it is the single entry of a region with a
+// single exit (the post-dominator)
+//
+// a loop header is a node that dominates a source of an edge into it, such
+// an edge is a back edge
+//
+// the loop depth is the maximum nesting depth of natural loops (0 when
+// there are no loops)
+
+typedef std::vector<BasicBlock*> BasicBlocksVectorTy;
+typedef std::function<bool(BasicBlock*)> BasicBlockPredicateTy;
+
+class CompactCFGTy {
+
+  std::unordered_map<BasicBlock*, BasicBlock*> nodes; // block -> node
+  std::unordered_map<BasicBlock*, BasicBlocksVectorTy> chains; // node -> blocks to process
+  std::unordered_map<BasicBlock*, unsigned> ranks;
+  unsigned nranks;
+  BasicBlocksSetTy regionEntries;
+  std::unordered_map<BasicBlock*, BasicBlocksSetTy> backEdges; // loop header -> sources of back edges
+  unsigned loopDepth;
+
+  public:
+    CompactCFGTy(): nodes(), chains(), ranks(), nranks(0), regionEntries(), backEdges(), loopDepth(0) {};
+
+    // isRelevant tells if a block has instructions the checker needs to visit
+    void reset(Function *f, const BasicBlocksSetTy& errorBasicBlocks, BasicBlockPredicateTy isRelevant);
+
+    BasicBlock* node(BasicBlock *bb) const {
+      auto ni = nodes.find(bb);
+      return (ni == nodes.end()) ? bb : ni->second;
+    }
+
+    const BasicBlocksVectorTy& blocks(BasicBlock *node) const {
+      return chains.at(node);
+    }
+
+    unsigned rank(BasicBlock *bb) const {
+      return ranks.at(bb);
+    }
+
+    unsigned getNRanks() const {
+      return nranks;
+    }
+
+    bool isRegionEntry(BasicBlock *node) const {
+      return regionEntries.find(node) != regionEntries.end();
+    }
+
+    bool isLoopHeader(BasicBlock *node) const {
+      return backEdges.find(node) != backEdges.end();
+    }
+
+    bool isBackEdge(BasicBlock *from, BasicBlock *node) const {
+      auto bi = backEdges.find(node);
+      return bi != backEdges.end() && bi->second.find(from) != bi->second.end();
+    }
+
+    unsigned getNLoopHeaders() const {
+      return backEdges.size();
+    }
+
+    unsigned getLoopDepth() const {
+      return loopDepth;
+    }
+};
+
+#endif
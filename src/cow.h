@@ -0,0 +1,93 @@
+#ifndef RCHK_COW_H
+#define RCHK_COW_H
+
+// copy-on-write value for components of checking states
+//
+// copying is O(1) (the value is shared) and the value is only copied
+// when written while shared, so cloning a state for a successor only
+// copies the components the successor later modifies
+//
+// this is not structural sharing: the first write to a shared value copies
+// all of it, which is fine for the small maps of the states
+//
+// reads go via * and ->, which only give const access, writes have to
+// go via write(); the checkers are single-threaded, so the reference
+// count is not atomic
+//
+// the hash of the value is cached with the (shared) value, so a state
+// only re-hashes the components it has written since it was cloned
+
+template <class T> class CowTy {
+
+  struct NodeTy {
+    T value;
+    unsigned refs;
+    size_t hashcode;
+    bool hashed;
+
+    NodeTy(const T& value): value(value), refs(1), hashcode(0), hashed(false) {};
+  };
+
+  NodeTy* node;
+
+  void release() {
+    if (node && --node->refs == 0) {
+      delete node;
+    }
+  }
+
+  public:
+    CowTy(): node(new NodeTy(T())) {};
+    CowTy(const T& value): node(new NodeTy(value)) {};
+    CowTy(const CowTy& other): node(other.node) { node->refs++; };
+    CowTy(CowTy&& other): node(other.node) { other.node = NULL; }; // other can only be destroyed or assigned to
+    ~CowTy() { release(); }
+
+    CowTy& operator=(const CowTy& other) {
+      other.node->refs++;
+      release();
+      node = other.node;
+      return *this;
+    }
+
+    CowTy& operator=(CowTy&& other) {
+      if (this != &other) {
+        release();
+        node = other.node;
+        other.node = NULL;
+      }
+      return *this;
+    }
+
+    const T& operator*() const { return node->value; }
+    const T* operator->() const { return &node->value; }
+
+    T& write() { // do not write via the reference after hash()
+      if (node->refs > 1) {
+        node->refs--;
+        node = new NodeTy(node->value);
+      }
+      node->hashed = false;
+      return node->value;
+    }
+
+    template <class Hasher> size_t hash(Hasher hasher) const {
+      if (!node->hashed) {
+        node->hashcode = hasher(node->value);
+        node->hashed = true;
+      }
+      return node->hashcode;
+    }
+
+    // erase from an associative container, copying it only when the key is present
+    template <class K> size_t erase(const K& key) {
+      if (!node->value.count(key)) {
+        return 0;
+      }
+      return write().erase(key);
+    }
+
+    bool operator==(const CowTy& other) const { return node == other.node || node->value == other.node->value; }
+};
+
+#endif
@@ -603,7 +603,7 @@ static void analyzeFunction(FunctionState& fstate, FunctionTableTy& functions, F
   }
 }
 
-CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFunctions) {
+CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFunctions, const FunctionIdsTy& functionIds) {
 
   FunctionTableTy functions; // function envelopes
   FunctionListTy workList; // functions to be re-analyzed
@@ -629,7 +629,7 @@ CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFun
       //   that it has been re-analyzed
   }  
   
-  CProtectInfo cprotect;
+  CProtectInfo cprotect(&functionIds);
   for(FunctionTableTy::iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
     Function* fun = fi->first;
     FunctionState& fstate = fi->second;
@@ -653,16 +653,16 @@ CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFun
         cpargs.at(i) = CP_CALLEE_PROTECT;
       }
     }
-    cprotect.map.insert({fun, cpargs});
+    unsigned funId = functionIds.idOf(fun);
+    cprotect.functions.at(funId) = cpargs;
+    cprotect.analyzed.at(funId) = true;
   }
 
   return cprotect;
 }
 
-bool CProtectInfo::isCalleeProtect(Function *fun, int argIndex, bool onlyNonTrivially) {
-  auto fsearch = map.find(fun);
-  myassert(fsearch != map.end()); 
-  CPArgsTy& cpargs = fsearch->second;
+bool CProtectInfo::isCalleeProtect(unsigned funId, int argIndex, bool onlyNonTrivially) const {
+  const CPArgsTy& cpargs = getArgs(funId);
   CPKind k = cpargs.at(argIndex);
   if (onlyNonTrivially) {
     return k == CP_CALLEE_PROTECT;
@@ -671,10 +671,8 @@ bool CProtectInfo::isCalleeProtect(Function *fun, int argIndex, bool onlyNonTriv
   }
 }
 
-bool CProtectInfo::isCalleeProtect(Function *fun, bool onlyNonTrivially) {
-  auto fsearch = map.find(fun);
-  myassert(fsearch != map.end()); 
-  CPArgsTy& cpargs = fsearch->second;
+bool CProtectInfo::isCalleeProtect(unsigned funId, bool onlyNonTrivially) const {
+  const CPArgsTy& cpargs = getArgs(funId);
   
   unsigned nargs = cpargs.size();
   bool seenNonTrivial = false;
@@ -697,10 +695,8 @@ bool CProtectInfo::isCalleeProtect(Function *fun, bool onlyNonTrivially) {
   }
 }
 
-bool CProtectInfo::isCalleeSafe(Function *fun, int argIndex, bool onlyNonTrivially) {
-  auto fsearch = map.find(fun);
-  myassert(fsearch != map.end()); 
-  CPArgsTy& cpargs = fsearch->second;
+bool CProtectInfo::isCalleeSafe(unsigned funId, int argIndex, bool onlyNonTrivially) const {
+  const CPArgsTy& cpargs = getArgs(funId);
   
   CPKind k = cpargs.at(argIndex);
   
@@ -711,10 +707,8 @@ bool CProtectInfo::isCalleeSafe(Function *fun, int argIndex, bool onlyNonTrivial
   }
 }
 
-bool CProtectInfo::isCalleeSafe(Function *fun, bool onlyNonTrivially) {
-  auto fsearch = map.find(fun);
-  myassert(fsearch != map.end()); 
-  CPArgsTy& cpargs = fsearch->second;
+bool CProtectInfo::isCalleeSafe(unsigned funId, bool onlyNonTrivially) const {
+  const CPArgsTy& cpargs = getArgs(funId);
   
   unsigned nargs = cpargs.size();
   bool seenNonTrivial = false;
@@ -737,11 +731,9 @@ bool CProtectInfo::isCalleeSafe(Function *fun, bool onlyNonTrivially) {
   }
 }
 
-bool CProtectInfo::isNonTrivial(Function *fun) {
+bool CProtectInfo::isNonTrivial(unsigned funId) const {
 
-  auto fsearch = map.find(fun);
-  myassert(fsearch != map.end()); 
-  CPArgsTy& cpargs = fsearch->second;
+  const CPArgsTy& cpargs = getArgs(funId);
   
   unsigned nargs = cpargs.size();
   
@@ -3,7 +3,7 @@
 
 #include "common.h"
 
-#include <unordered_map>
+#include <vector>
 
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Function.h>
@@ -18,33 +18,48 @@ enum CPKind {
 };
   
 typedef std::vector<CPKind> CPArgsTy;
-typedef std::unordered_map<Function*, CPArgsTy> CPMapTy;
+typedef std::vector<CPArgsTy> CPFunctionsTy; // indexed by function id
 
 struct CProtectInfo {
   
-  CPMapTy map;
+  CPFunctionsTy functions;
+  FunctionsBitsTy analyzed; // functions with kinds in functions
+  const FunctionIdsTy* functionIds;
   
-  CProtectInfo(): map() {};
+  CProtectInfo(const FunctionIdsTy* functionIds): functions(functionIds->size()), analyzed(functionIds->size(), false), functionIds(functionIds) {};
   
-  bool isCalleeProtect(Function *fun, int argIndex, bool onlyNonTrivially);
+  const CPArgsTy& getArgs(unsigned funId) const {
+    myassert(hasFunction(analyzed, funId) && "function not analyzed for callee-protect");
+    return functions[funId];
+  }
+  const CPArgsTy& getArgs(Function *fun) const { return getArgs(functionIds->idOf(fun)); }
+  
+  // the functions can be identified by their module-wide id (FunctionIdsTy)
+  
+  bool isCalleeProtect(unsigned funId, int argIndex, bool onlyNonTrivially) const;
     // trivially, non-allocating function or function with no SEXP arguments is callee protect
 
-  bool isCalleeSafe(Function *fun, int argIndex, bool onlyNonTrivially);
+  bool isCalleeSafe(unsigned funId, int argIndex, bool onlyNonTrivially) const;
     // trivially, callee protect function is callee safe
     // also, trivially callee protect function is callee safe
   
-  bool isCalleeProtect(Function *fun, bool onlyNonTrivially);
+  bool isCalleeProtect(unsigned funId, bool onlyNonTrivially) const;
     // a callee protect function has all its arguments callee protect
     // a non-trivially callee protect function has at least one of its arguments
     //   callee-protect non-trivially
     
-  bool isCalleeSafe(Function *fun, bool onlyNonTrivially);
+  bool isCalleeSafe(unsigned funId, bool onlyNonTrivially) const;
   
-  bool isNonTrivial(Function *fun);
+  bool isNonTrivial(unsigned funId) const;
     // does it have any argument with non-trivial protection (callee safe, callee protect or caller protect)?
     
+  bool isCalleeProtect(Function *fun, int argIndex, bool onlyNonTrivially) const { return isCalleeProtect(functionIds->idOf(fun), argIndex, onlyNonTrivially); }
+  bool isCalleeSafe(Function *fun, int argIndex, bool onlyNonTrivially) const { return isCalleeSafe(functionIds->idOf(fun), argIndex, onlyNonTrivially); }
+  bool isCalleeProtect(Function *fun, bool onlyNonTrivially) const { return isCalleeProtect(functionIds->idOf(fun), onlyNonTrivially); }
+  bool isCalleeSafe(Function *fun, bool onlyNonTrivially) const { return isCalleeSafe(functionIds->idOf(fun), onlyNonTrivially); }
+  bool isNonTrivial(Function *fun) const { return isNonTrivial(functionIds->idOf(fun)); }
 };
 
-CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFunctions);
+CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFunctions, const FunctionIdsTy& functionIds);
 
 #endif
@@ -40,6 +40,9 @@ bool isAssertedNonAllocating(const CalledFunctionTy *f) {
 }
 
 
+// functions where guards blow up the states; bcheck detects these by itself
+//   (DROP_HOSTILE_GUARDS), but the lists are still used by callocators
+
 bool avoidSEXPGuardsFor(Function *f) {
   if (f->getName() == "bcEval") return true;
   return false;
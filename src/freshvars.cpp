@@ -25,34 +25,38 @@ static void pruneFreshVars(Instruction *in, FreshVarsTy& freshVars, LiveVarsTy&
   //   remove entries and conditional messages for dead variables
   //   also print conditional messages for variables that are now definitely going to be used
     
-  for (FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe;) {
+  if (freshVars.vars->empty()) {
+    return;
+  }
+  auto lsearch = liveVars.find(in);
+  myassert(lsearch != liveVars.end());
+  VarsLiveness& lvars = lsearch->second;
+
+  VarsVectorTy deadVars; // erased after the loop, so that unchanged vars are not copied
+  for (FreshVarsVarsTy::const_iterator fi = freshVars.vars->begin(), fe = freshVars.vars->end(); fi != fe; ++fi) {
     AllocaInst *var = fi->first;
       
-    auto lsearch = liveVars.find(in);
-    myassert(lsearch != liveVars.end());
-      
-    VarsLiveness& lvars = lsearch->second;
     if (!lvars.isPossiblyUsed(var)) {
-      fi = freshVars.vars.erase(fi);
-      freshVars.condMsgs.erase(var);
-      continue;
+      deadVars.push_back(var);
 
-    } else if (!lvars.isPossiblyKilled(var)) {
-      auto msearch = freshVars.condMsgs.find(var);
-      if (msearch != freshVars.condMsgs.end()) {
-        msearch->second.flush();
-        refinableInfos++;
-        freshVars.condMsgs.erase(msearch);
-        if (msg.debug()) msg.debug(MSG_PFX + "printed conditional messages as variable " + varName(var) + " is now definitely going to be used", in);
-      }
+    } else if (!lvars.isPossiblyKilled(var) && freshVars.condMsgs->count(var)) {
+      DelayedLineMessenger dmsg(&msg, freshVars.condMsgs->at(var));
+      dmsg.flush();
+      refinableInfos++;
+      freshVars.condMsgs.erase(var);
+      if (msg.debug()) msg.debug(MSG_PFX + "printed conditional messages as variable " + varName(var) + " is now definitely going to be used", in);
     }
-    ++fi;
+  }
+  for (VarsVectorTy::iterator vi = deadVars.begin(), ve = deadVars.end(); vi != ve; ++vi) {
+    freshVars.vars.write().erase(*vi);
+    freshVars.condMsgs.erase(*vi);
   }
 }
 
 static void unprotectAll(FreshVarsTy& freshVars) {
-  freshVars.pstack.clear();
-  for (FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe; ++fi) {
+  freshVars.pstack.write().clear();
+  FreshVarsVarsTy& vars = freshVars.vars.write();
+  for (FreshVarsVarsTy::iterator fi = vars.begin(), fe = vars.end(); fi != fe; ++fi) {
     fi->second = 0; // zero protect count
   }
 }
@@ -73,20 +77,23 @@ static void issueConditionalMessage(Instruction *in, AllocaInst *var, FreshVarsT
   } 
     
   // prepare a conditional message - the variable may be live, but we don't know
-  auto vsearch = freshVars.condMsgs.find(var);
-  if (vsearch == freshVars.condMsgs.end()) {
+  auto vsearch = freshVars.condMsgs->find(var);
+  if (vsearch == freshVars.condMsgs->end()) {
     DelayedLineMessenger dmsg(&msg);
     dmsg.info(MSG_PFX + message, in);
-    freshVars.condMsgs.insert({var, dmsg});
+    freshVars.condMsgs.write().insert({var, dmsg.messages});
     if (msg.debug()) msg.debug(MSG_PFX + "created conditional message \"" + message + "\" first for variable " + varName(var), in);
   } else {
-    DelayedLineMessenger& dmsg = vsearch->second;
+    DelayedLineMessenger dmsg(&msg, vsearch->second);
     dmsg.info(MSG_PFX + message, in);
+    if (dmsg.messages != vsearch->second) {
+      freshVars.condMsgs.write()[var] = dmsg.messages;
+    }
     if (msg.debug()) msg.debug(MSG_PFX + "added conditional message \"" + message + "\" for variable " + varName(var) + "(size " + std::to_string(dmsg.size()) + ")", in);
   }
 }
 
-static bool isVarCheckedFresh(AllocaInst *var) {
+bool isVarCheckedFresh(AllocaInst *var) {
 
   for(Value::user_iterator ui = var->user_begin(), ue = var->user_end(); ui != ue; ++ui) {
     User *u = *ui;
@@ -104,41 +111,37 @@ static bool isVarCheckedFresh(AllocaInst *var) {
   return true;
 }
 
-static bool isVarCheckedFresh(AllocaInst *var, VarBoolCacheTy& cache, LineMessenger& msg) {
+static bool isVarCheckedFresh(AllocaInst *var, VarTableTy& vars, LineMessenger& msg) {
 
-  if (!isSEXP(var)) {
+  unsigned flags = vars.get(var);
+  if (!(flags & VF_SEXP)) {
     return false;
   }
-
-  auto vsearch = cache.find(var);
-  if (vsearch != cache.end()) {
-    return vsearch->second;
+  if (flags & VF_CHECKED_FRESH) {
+    return true;
   }
   
-  bool isChecked = isVarCheckedFresh(var);
-  
-  if (!isChecked) {
+  if (!(flags & VF_REPORTED)) {
     // the message is here to make sure it is printed only once
     //   the line messenger mechanism for printing unique messages won't do in practice
     //   because generating the message is too expensive
     msg.info(MSG_PFX + "ignoring variable " + varName(var) + " as it has address taken, results will be incomplete ", NULL);  
+    vars.set(var, VF_REPORTED);
   }
-  
-  cache.insert({var, isChecked});
-  return isChecked;
+  return false;
 }
 
 static void unprotectOne(FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, Instruction *in) {
 
-  AllocaInst* var = freshVars.pstack.back();
-  freshVars.pstack.pop_back();
+  AllocaInst* var = freshVars.pstack->back();
+  freshVars.pstack.write().pop_back();
 
   if (!var) {
     return;
   }
   
-  auto vsearch = freshVars.vars.find(var);
-  if (vsearch != freshVars.vars.end()) {  // decrement protect count of a possibly fresh variable
+  if (freshVars.vars->count(var)) {  // decrement protect count of a possibly fresh variable
+    auto vsearch = freshVars.vars.write().find(var);
     int nProtects = vsearch->second;
     nProtects--;
     if (nProtects < 0) {
@@ -161,7 +164,7 @@ static void unprotectOne(FreshVarsTy& freshVars, LineMessenger& msg, unsigned& r
 }
 
 static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *sexpGuardsChecker, SEXPGuardsTy *sexpGuards, FreshVarsTy& freshVars,
-    LineMessenger& msg, unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect, BalanceStateTy* balance, VarBoolCacheTy& checkedVarsCache) {
+    LineMessenger& msg, unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect, BalanceStateTy* balance, VarTableTy& vars) {
   
   bool confused = QUIET_WHEN_CONFUSED && freshVars.confused;
 
@@ -248,7 +251,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
         }
       }
       
-      if (var && !isVarCheckedFresh(var, checkedVarsCache, msg)) {
+      if (var && !isVarCheckedFresh(var, vars, msg)) {
         var = NULL; // fall back below into pushing anonymous value on the stack
       }
     
@@ -259,8 +262,8 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
           return;
         }
       
-        auto vsearch = freshVars.vars.find(var);
-        if (vsearch != freshVars.vars.end()) {
+        auto vsearch = freshVars.vars->find(var);
+        if (vsearch != freshVars.vars->end()) {
           int nProtects = vsearch->second;
           if (nProtects > 0) {
             if (msg.debug()) msg.debug(MSG_PFX + "left alone protect count of variable " + varName(var) + " on " + std::to_string(nProtects) + " at REPROTECT", in);
@@ -269,7 +272,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
             // typically it was before protected just once, so lets set its protect count to 1
           
             nProtects = 1;
-            vsearch->second = nProtects;
+            freshVars.vars.write()[var] = nProtects;
             if (msg.debug()) msg.debug(MSG_PFX + "set protect count of variable " + varName(var) + " to 1 at REPROTECT (heuristic)", in);
           }	
         } else {
@@ -278,13 +281,13 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
           // the variable is not currently fresh, but the fact that it is being reprotected actually means
           //   that there is probably a reason to protect it
         
-          freshVars.vars.insert({var, 1});
+          freshVars.vars.write().insert({var, 1});
           if (msg.debug()) msg.debug(MSG_PFX + "non-fresh variable " + varName(var) + " is being REPROTECTed, inserting it as fresh with protectcount 1", in); 
         }
         return;  
       }
 
-      if (freshVars.pstack.size() == MAX_PSTACK_SIZE) {
+      if (freshVars.pstack->size() == MAX_PSTACK_SIZE) {
         unprotectAll(freshVars);
         refinableInfos++;
         msg.info(MSG_PFX + "protect stack is too deep, unprotecting all variables, " + CONFUSION_DISCLAIMER, NULL);
@@ -293,15 +296,16 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
       }
     
       if (var) {
-        freshVars.pstack.push_back(var);
-        if (msg.debug()) msg.debug(MSG_PFX + "pushed variable " + varName(var) + " to the protect stack (size " + std::to_string(freshVars.pstack.size()) + ")", in);
+        freshVars.pstack.write().push_back(var);
+        if (msg.debug()) msg.debug(MSG_PFX + "pushed variable " + varName(var) + " to the protect stack (size " + std::to_string(freshVars.pstack->size()) + ")", in);
 
         // NOTE: the handling of PROTECT(x = foo()) only will increment x's protectcount correctly
         // if the store x = %tmpvalue is done _before_ the call PROTECT(%tmpvalue)
         //   (otherwise the store would normally set the protectcount to zero)
         
-        auto vsearch = freshVars.vars.find(var);
-        if (vsearch != freshVars.vars.end()) {
+        FreshVarsVarsTy& vars = freshVars.vars.write();
+        auto vsearch = vars.find(var);
+        if (vsearch != vars.end()) {
           int nProtects = vsearch->second;
           vsearch->second = ++nProtects;
           if (msg.debug()) msg.debug(MSG_PFX + "incremented protect count of variable " + varName(var) + " to " + std::to_string(nProtects), in); 
@@ -310,14 +314,14 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
           //   that there is probably a reason to protect it, so when unprotected, it should be then treated
           //   as fresh again... so lets add it with protect count of 1
         
-          freshVars.vars.insert({var, 1});
+          vars.insert({var, 1});
           if (msg.debug()) msg.debug(MSG_PFX + "non-fresh variable " + varName(var) + " is being protected, inserting it as fresh with protectcount 1", in); 
         }
         return;
       }
 
-      freshVars.pstack.push_back(NULL);
-      if (msg.debug()) msg.debug(MSG_PFX + "pushed anonymous value to the protect stack (size " + std::to_string(freshVars.pstack.size()) + ")", in);
+      freshVars.pstack.write().push_back(NULL);
+      if (msg.debug()) msg.debug(MSG_PFX + "pushed anonymous value to the protect stack (size " + std::to_string(freshVars.pstack->size()) + ")", in);
     }
   
     if (f->getName() == "Rf_unprotect") {
@@ -343,9 +347,9 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
       }
       
       if (haveCount) {
-        if (unprotectCount > freshVars.pstack.size()) {
+        if (unprotectCount > freshVars.pstack->size()) {
           msg.info(MSG_PFX + "attempt to unprotect more items (" + std::to_string(unprotectCount) + ") than protected ("
-            + std::to_string(freshVars.pstack.size()) + "), " + CONFUSION_DISCLAIMER, in);
+            + std::to_string(freshVars.pstack->size()) + "), " + CONFUSION_DISCLAIMER, in);
           
           refinableInfos++;
           if (QUIET_WHEN_CONFUSED) freshVars.confused = true;
@@ -372,7 +376,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
   
   // calling an allocating function
   
-  if (!protectsArguments(tgt) && !cprotect.isCalleeSafe(tgt->fun, false)) {
+  if (!protectsArguments(tgt) && !cprotect.isCalleeSafe(tgt->funId, false)) {
     // this check can be done even when the tool is confused
     unsigned aidx = 0;
     for(CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end(); ai != ae; ++ai, ++aidx) {
@@ -381,7 +385,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
       if (!src || !cm->isPossibleCAllocator(src)) {
         continue;
       }
-      if (aidx < tgt->fun->arg_size() && cprotect.isCalleeSafe(tgt->fun, aidx, false)) {
+      if (aidx < tgt->fun->arg_size() && cprotect.isCalleeSafe(tgt->funId, aidx, false)) {
         // we are directly passing an argument, so it does not matter the argument is destroyed by the call
         // (well, except that the value may be used again, in the LLVM bitcode -- it is an approximation that we ignore this)
         continue;
@@ -396,7 +400,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
   }
   
   pruneFreshVars(in, freshVars, liveVars, msg, refinableInfos); // make sure messages are not emitted for (obviously) dead variables
-  if (freshVars.vars.size() > 0) {
+  if (freshVars.vars->size() > 0) {
   
     if (msg.trace()) msg.trace(MSG_PFX + "checking freshvars at allocating call to " + funName(tgt), in);
   
@@ -437,7 +441,8 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
       }
     }
   
-    for (FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe; ++fi) {
+    const FreshVarsVarsTy& vars = *freshVars.vars; // issueConditionalMessage only writes condMsgs
+    for (FreshVarsVarsTy::const_iterator fi = vars.begin(), fe = vars.end(); fi != fe; ++fi) {
       AllocaInst *var = fi->first;
       
       int nProtects = fi->second;
@@ -475,16 +480,16 @@ static void handleLoad(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker* s
   // a variable is being loaded
   
   // check for conditional messages
-  auto msearch = freshVars.condMsgs.find(var);
-  if (msearch != freshVars.condMsgs.end()) {
-    msearch->second.flush();
+  if (freshVars.condMsgs->count(var)) {
+    DelayedLineMessenger dmsg(&msg, freshVars.condMsgs->at(var));
+    dmsg.flush();
     refinableInfos++;
-    freshVars.condMsgs.erase(msearch);
+    freshVars.condMsgs.erase(var);
     if (msg.debug()) msg.debug(MSG_PFX + "printed conditional messages on use of variable " + varName(var), in);
   }
   
-  auto vsearch = freshVars.vars.find(var);
-  if (vsearch == freshVars.vars.end()) { 
+  auto vsearch = freshVars.vars->find(var);
+  if (vsearch == freshVars.vars->end()) { 
     return;
   }
   int nProtects = vsearch->second;
@@ -505,8 +510,8 @@ static void handleLoad(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker* s
             if (AllocaInst* firstArg = dyn_cast<AllocaInst>(firstArgLoad->getPointerOperand())) {
             
               if (firstArg != var) {
-                auto vsearch = freshVars.vars.find(firstArg);
-                if (vsearch == freshVars.vars.end() || (vsearch->second > 0)) {
+                auto vsearch = freshVars.vars->find(firstArg);
+                if (vsearch == freshVars.vars->end() || (vsearch->second > 0)) {
                   // first argument of the setter is not fresh
                 
                   if (msg.debug()) msg.debug(MSG_PFX + "fresh variable " + varName(var) + " passed to known setter function (possibly implicitly protecting) " + funName(tgt) + " and thus no longer fresh" , in);
@@ -545,7 +550,7 @@ static void handleLoad(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker* s
   //   or if the function allocates only after the fresh argument is no longer needed    
     
   const CalledFunctionTy* tgt = cm->getCalledFunction(li->user_back(), sexpGuardsChecker, sexpGuards, false);
-  if (!tgt || !cm->isCAllocating(tgt) || protectsArguments(tgt) || cprotect.isCalleeProtect(tgt->fun, false)) {
+  if (!tgt || !cm->isCAllocating(tgt) || protectsArguments(tgt) || cprotect.isCalleeProtect(tgt->funId, false)) {
     return;
   }
   
@@ -564,7 +569,7 @@ static void handleLoad(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker* s
   }
   myassert(aidx < cs.arg_size());
 
-  if (aidx < tgt->fun->arg_size() && cprotect.isCalleeProtect(tgt->fun, aidx, false)) {
+  if (aidx < tgt->fun->arg_size() && cprotect.isCalleeProtect(tgt->funId, aidx, false)) {
     return; // the variable is callee-protect for the given argument
   }
 
@@ -573,7 +578,7 @@ static void handleLoad(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker* s
     nameSuffix = " <arg " + std::to_string(aidx+1) + ">";
   }
   
-  if (aidx >= tgt->fun->arg_size()  || !cprotect.isCalleeSafe(tgt->fun, aidx, false)) {
+  if (aidx >= tgt->fun->arg_size()  || !cprotect.isCalleeSafe(tgt->funId, aidx, false)) {
     // passing an unprotected argument to a function parameter that is not callee-safe, this is always an error
     
 
@@ -625,7 +630,7 @@ static void unfreshAliasedVars(Instruction *useInst, AllocaInst *useVar, FreshVa
 }
 
 static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *sexpGuardsChecker, SEXPGuardsTy *sexpGuards, 
-  FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, BalanceStateTy* balance, VarBoolCacheTy& checkedVarsCache) {
+  FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, BalanceStateTy* balance, VarTableTy& vars) {
   
   if (QUIET_WHEN_CONFUSED && freshVars.confused) {
     return;
@@ -659,7 +664,7 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
           int newDepth = balance->savedDepth;
           myassert(newDepth >= 0);
       
-          int curDepth = freshVars.pstack.size();
+          int curDepth = freshVars.pstack->size();
           if (newDepth > curDepth) {
             msg.info(MSG_PFX + "attempt to restore protection stack to higher depth than it has now, " + CONFUSION_DISCLAIMER, in);
             if (QUIET_WHEN_CONFUSED) freshVars.confused = true;
@@ -670,7 +675,7 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
             return;
           }
       
-          while((int)freshVars.pstack.size() != newDepth) {
+          while((int)freshVars.pstack->size() != newDepth) {
             unprotectOne(freshVars, msg, refinableInfos, in);
           }
           return;
@@ -686,7 +691,7 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
     return;
   }
   AllocaInst *var = cast<AllocaInst>(storePointerOp);
-  if (!isVarCheckedFresh(var, checkedVarsCache, msg)) {
+  if (!isVarCheckedFresh(var, vars, msg)) {
     return;
   }
   
@@ -726,8 +731,8 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
             if (LoadInst* firstArgLoad = dyn_cast<LoadInst>(cs.getArgument(0))) {
               if (AllocaInst* firstArg = dyn_cast<AllocaInst>(firstArgLoad->getPointerOperand())) {
             
-                auto vsearch = freshVars.vars.find(firstArg);
-                if (vsearch == freshVars.vars.end() || (vsearch->second > 0)) {
+                auto vsearch = freshVars.vars->find(firstArg);
+                if (vsearch == freshVars.vars->end() || (vsearch->second > 0)) {
                   // first argument of the setter is not fresh
 
                   Value *protArg = cs.getArgument(1); // the argument being implicitly protected
@@ -744,13 +749,7 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
       }
       
       int nProtects = 0;
-      auto vsearch = freshVars.vars.find(var);
-      if (vsearch == freshVars.vars.end()) {
-        freshVars.vars.insert({var, nProtects});
-        // remember, insert won't overwrite std::map value for an existing key
-      } else {
-        vsearch->second = nProtects;
-      }
+      freshVars.vars.write()[var] = nProtects;
       if (msg.debug()) msg.debug(MSG_PFX + "initialized fresh SEXP variable " + varName(var) + " with protect count " + std::to_string(nProtects) +
         " allocated by " + funName(srcFun), in);
       return;
@@ -761,20 +760,14 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
       if (dgep->isInBounds()) {
         if (LoadInst *dlis = dyn_cast<LoadInst>(dgep->getOperand(0))) {
           if (AllocaInst *dvars = dyn_cast<AllocaInst>(dlis->getPointerOperand())) {
-            if (isVarCheckedFresh(dvars, checkedVarsCache, msg)) {
-              auto vssearch = freshVars.vars.find(dvars);
-              if (vssearch != freshVars.vars.end() && vssearch->second == 0) {
+            if (isVarCheckedFresh(dvars, vars, msg)) {
+              auto vssearch = freshVars.vars->find(dvars);
+              if (vssearch != freshVars.vars->end() && vssearch->second == 0) {
                 // handle var = ATTRIB(var1) where var1 is fresh
                 // NOTE: this is only an approximation and can cause false alarms
                 //   if var1 later is protected, var still will be deemed fresh
                 int nProtects = 0;
-                auto vsearch = freshVars.vars.find(var);
-                if (vsearch == freshVars.vars.end()) {
-                  freshVars.vars.insert({var, nProtects});
-                  // remember, insert won't overwrite std::map value for an existing key
-                } else {
-                  vsearch->second = nProtects;
-                }
+                freshVars.vars.write()[var] = nProtects;
                 if (msg.debug()) msg.debug(MSG_PFX + "initialized fresh SEXP variable " + varName(var) + " with protect count " + std::to_string(nProtects) +
                   " based on derived assignment from fresh variable " + varName(dvars), in);
                 return;
@@ -787,18 +780,17 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
   }
   
   // the store turns a variable into non-fresh  
-  if (freshVars.vars.find(var) != freshVars.vars.end()) {
-    freshVars.vars.erase(var);
+  if (freshVars.vars.erase(var)) {
     if (msg.debug()) msg.debug(MSG_PFX + "fresh variable " + varName(var) + " rewritten and thus no longer fresh", in);
   }
 }
 
 void handleFreshVarsForNonTerminator(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *sexpGuardsChecker, SEXPGuardsTy *sexpGuards,
-    FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect, BalanceStateTy* balance, VarBoolCacheTy& checkedVarsCache) {
+    FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect, BalanceStateTy* balance, VarTableTy& vars) {
 
-  handleCall(in, cm, sexpGuardsChecker, sexpGuards, freshVars, msg, refinableInfos, liveVars, cprotect, balance, checkedVarsCache);
+  handleCall(in, cm, sexpGuardsChecker, sexpGuards, freshVars, msg, refinableInfos, liveVars, cprotect, balance, vars);
   handleLoad(in, cm, sexpGuardsChecker, sexpGuards, freshVars, msg, refinableInfos, liveVars, cprotect);
-  handleStore(in, cm, sexpGuardsChecker, sexpGuards, freshVars, msg, refinableInfos, balance, checkedVarsCache);
+  handleStore(in, cm, sexpGuardsChecker, sexpGuards, freshVars, msg, refinableInfos, balance, vars);
 }
 
 void handleFreshVarsForTerminator(Instruction *in, FreshVarsTy& freshVars, LiveVarsTy& liveVars) {
@@ -807,7 +799,7 @@ void handleFreshVarsForTerminator(Instruction *in, FreshVarsTy& freshVars, LiveV
 void StateWithFreshVarsTy::dump(bool verbose) {
 
   errs() << "=== fresh vars: " << &freshVars << " confused: " << freshVars.confused << "\n";
-  for(FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe; ++fi) {
+  for(FreshVarsVarsTy::const_iterator fi = freshVars.vars->begin(), fe = freshVars.vars->end(); fi != fe; ++fi) {
     AllocaInst *var = fi->first;
     errs() << "   " << varName(var);
     if (verbose) {
@@ -817,18 +809,17 @@ void StateWithFreshVarsTy::dump(bool verbose) {
     int depth = fi->second;
     errs() << " " << std::to_string(depth);
     
-    auto vsearch = freshVars.condMsgs.find(var);
-    if (vsearch != freshVars.condMsgs.end()) {
+    auto vsearch = freshVars.condMsgs->find(var);
+    if (vsearch != freshVars.condMsgs->end()) {
       errs() << " conditional messages: \n";
-      DelayedLineMessenger& dmsg = vsearch->second;
-      dmsg.print("    ");
+      printDelayedMessages(vsearch->second, "    ");
     }
     
     errs() << "\n";
   }
   errs() << " protect stack:";
 
-  for(VarsVectorTy::iterator vi = freshVars.pstack.begin(), ve = freshVars.pstack.end(); vi != ve; ++vi) {
+  for(VarsVectorTy::const_iterator vi = freshVars.pstack->begin(), ve = freshVars.pstack->end(); vi != ve; ++vi) {
     AllocaInst* var = *vi;
 
     errs() << " ";
@@ -9,6 +9,8 @@
 #include "liveness.h"
 #include "cprotect.h"
 #include "balance.h"
+#include "cow.h"
+#include "vartable.h"
 
 #include <vector>
 
@@ -20,11 +22,11 @@ using namespace llvm;
 const int MAX_PSTACK_SIZE = 64;
 
 typedef std::map<AllocaInst*, int> FreshVarsVarsTy;
-typedef std::map<AllocaInst*, DelayedLineMessenger> ConditionalMessagesTy;
+typedef std::map<AllocaInst*, const LineInfoPtrSetTy*> ConditionalMessagesTy; // interned message sets (see DelayedLineMessenger)
 typedef std::vector<AllocaInst*> VarsVectorTy;
 
-struct FreshVarsTy {
-  FreshVarsVarsTy vars;
+struct FreshVarsTy { // components are copy-on-write, so that states can be cloned cheaply
+  CowTy<FreshVarsVarsTy> vars;
     // variables known to hold newly allocated pointers (SEXPs)
     // attempts to include only reliably unprotected pointers,
 
@@ -35,13 +37,13 @@ struct FreshVarsTy {
     //   (implicitly protected variables are treated as non-fresh, hence
     //    they are not in this map)
 
-  VarsVectorTy pstack;
+  CowTy<VarsVectorTy> pstack;
     // protection stack
     // contains variables passed to PROTECT
     //   interprets UNPROTECT(const)
     //   zeroed on unsupported unprotect
 
-  ConditionalMessagesTy condMsgs;
+  CowTy<ConditionalMessagesTy> condMsgs;
     // info messages to be printed if a particular variable (key)
 
   bool confused = false; // the initialization should be implicit
@@ -63,8 +65,10 @@ struct StateWithFreshVarsTy : virtual public StateBaseTy {
 
 void handleFreshVarsForNonTerminator(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *sexpGuardsChecker, SEXPGuardsTy *sexpGuards,
   FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect, BalanceStateTy* balance,
-  VarBoolCacheTy& checkedVarsCache);
+  VarTableTy& vars);
 
 void handleFreshVarsForTerminator(Instruction *in, FreshVarsTy& freshVars, LiveVarsTy& liveVars);
 
+bool isVarCheckedFresh(AllocaInst *var); // the variable is supported by the checker (e.g. its address is not taken)
+
 #endif
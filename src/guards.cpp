@@ -3,14 +3,138 @@
 #include "patterns.h"
 #include "vectors.h"
 
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/InstIterator.h>
 
 #include <llvm/Support/raw_ostream.h>
 
 using namespace llvm;
 
+// guards possibly read later, at the start of each basic block (backward liveness)
+//
+// the state of a guard is consulted by instructions that use a value loaded
+//   from it, possibly in another block (e.g. load, compare, branch), so all
+//   these instructions are uses; a store to the guard is a definition
+//
+// a guard that is not live cannot influence any later branch, so the
+//   checkers forget it, so that it does not split the states
+
+template <unsigned BITS> static void findLiveGuards(Function *f, const GuardVarIndexTy& varIndex, GuardMasksTy& liveGuards) {
+
+  typedef FlatGuardsTy<BITS> GuardSetTy; // a guard is in the set when all its bits are set
+  typedef std::vector<std::pair<unsigned, bool>> AccessesTy; // guard index, is definition
+  
+  liveGuards.clear();
+  if (varIndex.size() == 0) {
+    return;
+  }
+  
+  std::unordered_map<Instruction*, AccessesTy> accesses;
+  for(unsigned idx = 0, nvars = varIndex.size(); idx < nvars; idx++) {
+    AllocaInst* var = varIndex.at(idx);
+    std::unordered_set<Instruction*> visited;
+    std::vector<Instruction*> workList;
+    
+    for(Value::user_iterator ui = var->user_begin(), ue = var->user_end(); ui != ue; ++ui) {
+      Instruction *in = dyn_cast<Instruction>(*ui);
+      if (!in) {
+        continue;
+      }
+      StoreInst *st = dyn_cast<StoreInst>(in);
+      if (st && st->getPointerOperand() == var && st->getValueOperand() != var) {
+        accesses[in].push_back({idx, true});
+        continue;
+      }
+      if (visited.insert(in).second) {
+        workList.push_back(in);
+      }
+    }
+    while(!workList.empty()) { // instructions depending on the value of the guard
+      Instruction *in = workList.back();
+      workList.pop_back();
+      accesses[in].push_back({idx, false});
+      for(Value::user_iterator ui = in->user_begin(), ue = in->user_end(); ui != ue; ++ui) {
+        Instruction *u = dyn_cast<Instruction>(*ui);
+        if (u && visited.insert(u).second) {
+          workList.push_back(u);
+        }
+      }
+    }
+  }
+  
+  std::unordered_map<BasicBlock*, GuardSetTy> gen; // read before written in the block
+  std::unordered_map<BasicBlock*, GuardSetTy> kill; // written before read in the block
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    GuardSetTy& bgen = gen.insert({bb, GuardSetTy(&varIndex)}).first->second;
+    GuardSetTy& bkill = kill.insert({bb, GuardSetTy(&varIndex)}).first->second;
+    for(BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
+      auto ai = accesses.find(&*ii);
+      if (ai == accesses.end()) {
+        continue;
+      }
+      for(unsigned defs = 0; defs < 2; defs++) { // an instruction reads before it writes
+        for(typename AccessesTy::const_iterator ei = ai->second.begin(), ee = ai->second.end(); ei != ee; ++ei) {
+          unsigned idx = ei->first;
+          if (ei->second != (bool) defs || bgen.getAt(idx) || bkill.getAt(idx)) {
+            continue;
+          }
+          if (ei->second) {
+            bkill.setBits(idx, GuardSetTy::VAR_MASK);
+          } else {
+            bgen.setBits(idx, GuardSetTy::VAR_MASK);
+          }
+        }
+      }
+    }
+    liveGuards.insert({bb, bgen.words});
+  }
+  
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(Function::iterator bi = f->end(), be = f->begin(); bi != be;) { // backwards converges faster
+      BasicBlock *bb = &*--bi;
+      std::vector<uint64_t>& live = liveGuards.at(bb);
+      const std::vector<uint64_t>& bgen = gen.at(bb).words;
+      const std::vector<uint64_t>& bkill = kill.at(bb).words;
+      
+      for(succ_iterator si = succ_begin(bb), se = succ_end(bb); si != se; ++si) {
+        const std::vector<uint64_t>& slive = liveGuards.at(*si);
+        for(unsigned w = 0, nwords = live.size(); w < nwords; w++) {
+          uint64_t add = (slive[w] & ~bkill[w]) | bgen[w];
+          if ((live[w] | add) != live[w]) {
+            live[w] |= add;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+}
+
+// a dropped guard is removed from the live guards of all blocks, so it is
+//   forgotten like a dead guard and no longer splits the states
+
+template <unsigned BITS> static bool dropLiveGuard(unsigned idx, GuardMasksTy& liveGuards, std::vector<bool>& droppedGuards) {
+
+  typedef FlatGuardsTy<BITS> GuardSetTy;
+
+  if (droppedGuards[idx]) {
+    return false;
+  }
+  droppedGuards[idx] = true;
+  unsigned w = idx / GuardSetTy::VARS_PER_WORD;
+  uint64_t bits = GuardSetTy::VAR_MASK << ((idx % GuardSetTy::VARS_PER_WORD) * BITS);
+  for(GuardMasksTy::iterator li = liveGuards.begin(), le = liveGuards.end(); li != le; ++li) {
+    li->second[w] &= ~bits;
+  }
+  return true;
+}
+
 // integer guard is a local variable
 //   which is compared at least once against a constant zero, but never compared against anything else
 //   which may be stored to and loaded from
@@ -79,16 +203,34 @@ static bool isIntegerGuardVariable(AllocaInst* var) {
   return nComparisons >= 2 || (nComparisons == 1 && (nConstantAssignments > 0 || nVariableAssignments > 0));
 }
 
-bool IntGuardsChecker::isGuard(AllocaInst* var) {
-  auto csearch = varsCache.find(var);
-  if (csearch != varsCache.end()) {
-    return csearch->second;
+void IntGuardsChecker::reset(Function *f, VarTableTy& vars) {
+  varIndex.clear();
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    if (AllocaInst *var = dyn_cast<AllocaInst>(&*ii)) {
+      if (isIntegerGuardVariable(var)) {
+        varIndex.indexOf(var);
+        vars.set(var, VF_INT_GUARD);
+      }
+    }
   }
+  findLiveGuards<IGS_BITS>(f, varIndex, liveGuards);
+  droppedGuards.assign(varIndex.size(), false);
+}
 
-  bool res = isIntegerGuardVariable(var);
-  
-  varsCache.insert({var, res});
-  return res;
+bool IntGuardsChecker::dropGuard(unsigned idx) {
+  return dropLiveGuard<IGS_BITS>(idx, liveGuards, droppedGuards);
+}
+
+void IntGuardsChecker::forgetDeadGuards(BasicBlock *bb, IntGuardsTy& intGuards) const {
+  auto li = liveGuards.find(bb);
+  if (li != liveGuards.end()) {
+    intGuards.retain(li->second);
+  }
+}
+
+bool IntGuardsChecker::isGuard(AllocaInst* var) {
+  unsigned idx;
+  return varIndex.find(var, idx);
 }
 
 std::string igs_name(IntGuardState gs) {
@@ -101,12 +243,7 @@ std::string igs_name(IntGuardState gs) {
 }
 
 IntGuardState IntGuardsChecker::getGuardState(const IntGuardsTy& intGuards, AllocaInst* var) {
-  auto gsearch = intGuards.find(var);
-  if (gsearch == intGuards.end()) {
-    return IGS_UNKNOWN;
-  } else {
-    return gsearch->second;
-  }
+  return intGuards.get(var);
 }
 
 void IntGuardsChecker::handleForNonTerminator(Instruction *in, IntGuardsTy& intGuards) {
@@ -150,21 +287,21 @@ void IntGuardsChecker::handleForNonTerminator(Instruction *in, IntGuardsTy& intG
       if (msg->debug()) msg->debug("integer guard variable " + varName(storePointerVar) + " (set to) unknown", store);
     } 
   }
-  intGuards[storePointerVar] = newState;
+  intGuards.set(storePointerVar, newState);
 }
 
-bool IntGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy& s) {
+AllocaInst* IntGuardsChecker::getBranchGuard(TerminatorInst* t) {
 
   if (!BranchInst::classof(t)) {
-    return false;
+    return NULL;
   }
   BranchInst* branch = cast<BranchInst>(t);
   if (!branch->isConditional() || !CmpInst::classof(branch->getCondition())) {
-    return false;
+    return NULL;
   }
   CmpInst* ci = cast<CmpInst>(branch->getCondition());
   if (!ci->isEquality()) {
-    return false;
+    return NULL;
   }
   // comparison with zero
   Value *constOp;
@@ -179,20 +316,31 @@ bool IntGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy&
   }
   
   if (!ConstantInt::classof(constOp) || !cast<ConstantInt>(constOp)->isZero()) {
-    return false;
+    return NULL;
   }
   if (!LoadInst::classof(load)) {
-    return false;
+    return NULL;
   }
   Value *loadOp = cast<LoadInst>(load)->getPointerOperand();
   if (!AllocaInst::classof(loadOp)) {
-    return false;
+    return NULL;
   }
   AllocaInst *var = cast<AllocaInst>(loadOp);
   if (!isGuard(var)) {
+    return NULL;
+  }
+  return var;
+}
+
+bool IntGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy& s) {
+
+  AllocaInst *var = getBranchGuard(t);
+  if (!var) {
     return false;
-  } 
+  }
   // if (intguard) ...
+  BranchInst* branch = cast<BranchInst>(t);
+  CmpInst* ci = cast<CmpInst>(branch->getCondition());
    
   IntGuardState g = getGuardState(s.intGuards, var);
   int succIndex = -1;
@@ -223,7 +371,7 @@ bool IntGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy&
     // true branch is possible
     {
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(0));
-      state->intGuards[var] = ci->isTrueWhenEqual() ? IGS_ZERO : IGS_NONZERO;
+      state->intGuards.set(var, ci->isTrueWhenEqual() ? IGS_ZERO : IGS_NONZERO);
       if (state->add()) {
         msg->trace("added true branch on integer guard of branch at", branch);
       }
@@ -233,7 +381,7 @@ bool IntGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy&
     // false branch is possible
     {
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(1));
-      state->intGuards[var] = ci->isTrueWhenEqual() ? IGS_NONZERO : IGS_ZERO;
+      state->intGuards.set(var, ci->isTrueWhenEqual() ? IGS_NONZERO : IGS_ZERO);
       if (state->add()) {
         msg->trace("added false branch on integer guard of branch at", branch);
       }
@@ -243,80 +391,27 @@ bool IntGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy&
 }
 
 PackedIntGuardsTy IntGuardsChecker::pack(const IntGuardsTy& intGuards) {
-
-  // note we first have to call indexOf on each variable to make sure
-  // it is indexed [later this should be perhaps done alreading when manipulating guards]
-  
-  for(IntGuardsTy::const_iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    varIndex.indexOf(var);
-  }  
-
-  PackedIntGuardsTy packed(varIndex.size());
-  
-  for(IntGuardsTy::const_iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    IntGuardState gs = gi->second;
-    
-    unsigned varIdx = varIndex.indexOf(var);
-    unsigned base = varIdx * IGS_BITS;
-    
-    switch(gs) {
-      case IGS_NONZERO: packed.bits[base] = true; break;     // 1 0
-      case IGS_ZERO:    packed.bits[base + 1] = true; break; // 0 1
-      case IGS_UNKNOWN: break;                               // implied 0 0
-    }
-    // 0 0 means UNKNOWN (or not included)
-  }
-
-  return packed;
+  return PackedIntGuardsTy(intGuards.words);
 }
 
 IntGuardsTy IntGuardsChecker::unpack(const PackedIntGuardsTy& intGuards) {
 
-  IntGuardsTy unpacked;
-  unsigned nvars = intGuards.bits.size() / IGS_BITS;
-  
-  myassert(nvars * IGS_BITS == intGuards.bits.size());
-  
-  for(unsigned varIdx = 0; varIdx < nvars; varIdx++) {
-    unsigned base = varIdx * IGS_BITS;
-    IntGuardState gs = IGS_UNKNOWN;
-    
-    if (intGuards.bits[base]) {
-      gs = IGS_NONZERO;  
-    } else if (intGuards.bits[base + 1]) {
-      gs = IGS_ZERO;
-    }
-    
-    if (gs != IGS_UNKNOWN) {
-      unpacked.insert({varIndex.at(varIdx), gs});
-    }
-  }
+  IntGuardsTy unpacked(&varIndex);
+  myassert(unpacked.words.size() == intGuards.words.size());
+  unpacked.words.assign(intGuards.words.data(), intGuards.words.data() + intGuards.words.size());
+  unpacked.rehash();
   return unpacked;
 }
-  
-void IntGuardsChecker::hash(size_t& res, const IntGuardsTy& intGuards) {
-
-  hash_combine(res, intGuards.size());
-  for(IntGuardsTy::const_iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    IntGuardState s = gi->second;
-    hash_combine(res, (void *)var);
-    hash_combine(res, (size_t) s);
-  } // ordered map
-}
 
 // SEXP guard is a local variable of type SEXP
 //   that follows the heuristics included below
 //   these heuristics are important because they keep the state space small(er)
 //   but also they are fragile - if something important is not a guard, the results will be less
 //     precise, may have more false alarms
+//
+// the type is checked by the caller (via VarTableTy)
 
-bool SEXPGuardsChecker::uncachedIsGuard(AllocaInst* var) {
-  if (!isSEXP(var)) {
-    return false;
-  }
+bool SEXPGuardsChecker::isGuardVariable(AllocaInst* var) {
   unsigned nComparisons = 0;
   unsigned nNilAssignments = 0;
   unsigned nCopies = 0;
@@ -405,54 +500,83 @@ bool SEXPGuardsChecker::uncachedIsGuard(AllocaInst* var) {
   return nVectorTests >= 1 || nComparisons >= 2 || ((nComparisons == 1 || nGEPs > 0 || nEscapesToCalls > 0) && (nNilAssignments + nCopies + nStoresFromArgument + nStoresFromFunction > 0));
 }
 
-bool SEXPGuardsChecker::isGuard(AllocaInst* var) {
-  auto csearch = varsCache.find(var);
-  if (csearch != varsCache.end()) {
-    return csearch->second;
+void SEXPGuardsChecker::reset(Function *f, VarTableTy& vars) {
+  varIndex.clear();
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    if (AllocaInst *var = dyn_cast<AllocaInst>(&*ii)) {
+      if (vars.isSEXP(var) && isGuardVariable(var)) {
+        varIndex.indexOf(var);
+        vars.set(var, VF_SEXP_GUARD);
+      }
+    }
   }
-
-  bool res = uncachedIsGuard(var);
+  nGuards = varIndex.size();
   
-  varsCache.insert({var, res});
-  return res;
+  // variables used with vector-only operations get a state, even when not guards
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    AllocaInst* vvar;
+    if (isVectorOnlyVarOperation(&*ii, vvar)) {
+      varIndex.indexOf(vvar);
+    }
+  }
+  findLiveGuards<SGS_BITS>(f, varIndex, liveGuards);
+  droppedGuards.assign(varIndex.size(), false);
+}
+
+bool SEXPGuardsChecker::dropGuard(unsigned idx) {
+  return dropLiveGuard<SGS_BITS>(idx, liveGuards, droppedGuards);
+}
+
+void SEXPGuardsChecker::forgetDeadGuards(BasicBlock *bb, SEXPGuardsTy& sexpGuards) const {
+  auto li = liveGuards.find(bb);
+  if (li != liveGuards.end()) {
+    sexpGuards.retain(li->second);
+  }
 }
 
-std::string sgs_name(SEXPGuardTy& g) {
+bool SEXPGuardsChecker::isGuard(AllocaInst* var) {
+  unsigned idx;
+  return varIndex.find(var, idx) && idx < nGuards;
+}
+
+std::string sgs_name(const SEXPGuardTy& g) {
 
   SEXPGuardState sgs = g.state;
   switch(sgs) {
     case SGS_NIL: return "nil (R_NilValue)";
     case SGS_NONNIL: return "non-nil (not R_NilValue)";
     case SGS_UNKNOWN: return "unknown";
-    case SGS_SYMBOL: return "symbol \"" + g.symbolName + "\"";
+    case SGS_SYMBOL: return "symbol \"" + getSymbolName(g.symbol) + "\"";
     case SGS_VECTOR: return "vector";
   }
   myassert(false);
 }
 
-SEXPGuardState SEXPGuardsChecker::getGuardState(const SEXPGuardsTy& sexpGuards, AllocaInst* var, std::string& symbolName) {
-  auto gsearch = sexpGuards.find(var);
-  if (gsearch == sexpGuards.end()) {
-    return SGS_UNKNOWN;
-  } else {
-    SEXPGuardState gs = gsearch->second.state;
-    if (gs == SGS_SYMBOL) {
-      symbolName = gsearch->second.symbolName;
-    }
-    return gs;
+SEXPGuardState SEXPGuardsChecker::getGuardState(const SEXPGuardsTy& sexpGuards, AllocaInst* var, SymbolIdTy& symbol) {
+  SEXPGuardTy g = sexpGuards.get(var);
+  if (g.state == SGS_SYMBOL) {
+    symbol = g.symbol;
   }
+  return g.state;
 }
 
 SEXPGuardState SEXPGuardsChecker::getGuardState(const SEXPGuardsTy& sexpGuards, AllocaInst* var) {
-  auto gsearch = sexpGuards.find(var);
-  if (gsearch == sexpGuards.end()) {
-    return SGS_UNKNOWN;
-  } else {
-    return gsearch->second.state;
+  return sexpGuards.get(var).state;
+}
+
+unsigned storedCallTargetId(Instruction* in, CalledModuleTy* cm) {
+  StoreInst* store = dyn_cast<StoreInst>(in);
+  if (!store) {
+    return FunctionIdsTy::NONE;
+  }
+  CallSite cs(store->getValueOperand());
+  if (!cs) {
+    return FunctionIdsTy::NONE;
   }
+  return cm->getFunctionId(cs.getCalledFunction());
 }
 
-void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& sexpGuards) {
+void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& sexpGuards, unsigned storedFunId) {
 
   // TODO: handle more "vector-only" operations, including passing to vector-only arguments of functions
   AllocaInst* vvar;
@@ -462,7 +586,7 @@ void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& se
     SEXPGuardState gs = getGuardState(sexpGuards, vvar);
     if (gs != SGS_VECTOR) {
       SEXPGuardTy newGS(SGS_VECTOR);
-      sexpGuards[vvar] = newGS;
+      sexpGuards.set(vvar, newGS);
       if (msg->debug()) msg->debug("sexp guard variable " + varName(vvar) + " set to vector because used with vector-only operation", in);
     }
     return;
@@ -488,15 +612,15 @@ void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& se
     Argument *arg = cast<Argument>(storeValueOp);
     const ArgInfoTy *ai = (*argInfos)[arg->getArgNo()];
     if (ai && ai->isSymbol()) { // sexpguard = symbol_argument
-      SEXPGuardTy newGS(SGS_SYMBOL, static_cast<const SymbolArgInfoTy*>(ai)->symbolName);
-      sexpGuards[storePointerVar] = newGS;
+      SEXPGuardTy newGS(SGS_SYMBOL, static_cast<const SymbolArgInfoTy*>(ai)->symbol);
+      sexpGuards.set(storePointerVar, newGS);
       if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to symbol \"" +
-        static_cast<const SymbolArgInfoTy*>(ai)->symbolName + "\" from argument\n", store);
+        static_cast<const SymbolArgInfoTy*>(ai)->getSymbolName() + "\" from argument\n", store);
       return;
     }
     if (ai && ai->isVector()) { // sexpguard = vector_argument
       SEXPGuardTy newGS(SGS_VECTOR);
-      sexpGuards[storePointerVar] = newGS;
+      sexpGuards.set(storePointerVar, newGS);
       if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to vector from argument\n", store);
       return;
     }
@@ -507,21 +631,20 @@ void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& se
     if (src == g->nilVariable) {  // sexpguard = R_NilValue
       if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to nil", store);
       SEXPGuardTy newGS(SGS_NIL);
-      sexpGuards[storePointerVar] = newGS;
+      sexpGuards.set(storePointerVar, newGS);
       return;
     }
     if (AllocaInst::classof(src) && 
         isGuard(cast<AllocaInst>(src))) { // sexpguard1 = sexpguard2
 
-      auto gsearch = sexpGuards.find(cast<AllocaInst>(src));
-      if (gsearch == sexpGuards.end()) {
-        sexpGuards.erase(storePointerVar);
+      SEXPGuardTy srcGS = sexpGuards.get(cast<AllocaInst>(src));
+      sexpGuards.set(storePointerVar, srcGS);
+      if (srcGS.state == SGS_UNKNOWN) {
         if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to unknown state because " +
           varName(cast<AllocaInst>(src)) + " is also unknown.", store);
       } else {
-        sexpGuards[storePointerVar] = gsearch->second;
         if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to state of " +
-          varName(cast<AllocaInst>(src)) + ", which is " + sgs_name(gsearch->second), store);
+          varName(cast<AllocaInst>(src)) + ", which is " + sgs_name(srcGS), store);
       }
       return;
     }
@@ -529,8 +652,8 @@ void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& se
       auto sfind = symbolsMap->find(cast<GlobalVariable>(src));
       if (sfind != symbolsMap->end()) {
         SEXPGuardTy newGS(SGS_SYMBOL, sfind->second);
-        sexpGuards[storePointerVar] = newGS;
-        if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to symbol \"" + sfind->second + "\" at assignment", store);
+        sexpGuards.set(storePointerVar, newGS);
+        if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to symbol \"" + getSymbolName(sfind->second) + "\" at assignment", store);
         return;
       } 
     }
@@ -540,33 +663,33 @@ void SEXPGuardsChecker::handleForNonTerminator(Instruction* in, SEXPGuardsTy& se
 
     if (acs && isVectorProducingCall(storeValueOp, cm, this, &sexpGuards)) {
       SEXPGuardTy newGS(SGS_VECTOR);
-      sexpGuards[storePointerVar] = newGS;
+      sexpGuards.set(storePointerVar, newGS);
       if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to vector (created by " + funName(atgt) +  ")", store);
       return;
     }
 
     if (acs) {
-      std::string symbolName;
-      if (isInstallConstantCall(storeValueOp, symbolName)) {
-        SEXPGuardTy newGS(SGS_SYMBOL, symbolName);
-        sexpGuards[storePointerVar] = newGS;
-        if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to symbol \"" + symbolName + "\" at install call " + funName(atgt), store);
+      SymbolIdTy symbol;
+      if (isInstallConstantCall(storeValueOp, symbol)) {
+        SEXPGuardTy newGS(SGS_SYMBOL, symbol);
+        sexpGuards.set(storePointerVar, newGS);
+        if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to symbol \"" + getSymbolName(symbol) + "\" at install call " + funName(atgt), store);
         return;        
       }
     }
     
     if (acs && possibleAllocators) { // sexpguard = fooAlloc()
-      Function *afun = acs.getCalledFunction();
-      if (possibleAllocators->find(afun) != possibleAllocators->end()) {
+      myassert(storedFunId == storedCallTargetId(store, cm));
+      if (hasFunction(*possibleAllocators, storedFunId)) {
         SEXPGuardTy newGS(SGS_NONNIL);
-        sexpGuards[storePointerVar] = newGS;
+        sexpGuards.set(storePointerVar, newGS);
         if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to non-nill (allocated by " + funName(atgt) + ")", store);
         return;
       }
     }
     
   }
-  sexpGuards.erase(storePointerVar);
+  sexpGuards.set(storePointerVar, SEXPGuardTy(SGS_UNKNOWN));
   if (msg->debug()) msg->debug("sexp guard variable " + varName(storePointerVar) + " set to unknown", store);
 }
 
@@ -610,7 +733,7 @@ bool SEXPGuardsChecker::handleNullCheck(bool positive, SEXPGuardState gs, Alloca
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(0));
       if (gs != SGS_SYMBOL && gs != SGS_VECTOR) {
         SEXPGuardTy newGS(positive ? SGS_NIL : SGS_NONNIL);
-        state->sexpGuards[guard] = newGS; // added information from that the true branch was taken
+        state->sexpGuards.set(guard, newGS); // added information from that the true branch was taken
       }
       if (state->add()) {
         msg->trace("added true branch on sexp guard of branch at", branch);
@@ -623,7 +746,7 @@ bool SEXPGuardsChecker::handleNullCheck(bool positive, SEXPGuardState gs, Alloca
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(1));
       if (gs != SGS_SYMBOL && gs != SGS_VECTOR) {
         SEXPGuardTy newGS(positive ? SGS_NONNIL : SGS_NIL);
-        state->sexpGuards[guard] = newGS; // added information from that the false branch was taken
+        state->sexpGuards.set(guard, newGS); // added information from that the false branch was taken
       }
       if (state->add()) {
         msg->trace("added false branch on sexp guard of branch at", branch);
@@ -708,7 +831,7 @@ bool SEXPGuardsChecker::handleTypeCheck(bool positive, int testedType, SEXPGuard
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(0)); // FIXME: capture that something is a symbol even if we don't know which one
       if (gs != SGS_SYMBOL && gs != SGS_VECTOR && isVectorType(testedType) && positive) {
         SEXPGuardTy newGS(SGS_VECTOR);
-        state->sexpGuards[guard] = newGS; // added information from that the true branch was taken (e.g. if it is a String, it is definitely a vector)
+        state->sexpGuards.set(guard, newGS); // added information from that the true branch was taken (e.g. if it is a String, it is definitely a vector)
       }      
       if (state->add()) {
         msg->trace("added true type branch on sexp guard of branch at", branch);
@@ -780,7 +903,7 @@ bool SEXPGuardsChecker::handleTypeSwitch(TerminatorInst* t, StateWithGuardsTy& s
       StateWithGuardsTy* state = s.clone(succ);
       if (newgs != gs) {
         SEXPGuardTy ng(newgs);
-        state->sexpGuards[var] = ng;
+        state->sexpGuards.set(var, ng);
       }
 
       if (state->add()) {
@@ -899,7 +1022,7 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
         StateWithGuardsTy* state = s.clone(branch->getSuccessor(0));
         if (gs != SGS_SYMBOL && impliesVectorWhenTrue(f)) {
           SEXPGuardTy newGS(SGS_VECTOR);
-          state->sexpGuards[guard] = newGS; // added information from that the true branch was taken
+          state->sexpGuards.set(guard, newGS); // added information from that the true branch was taken
         }
         if (state->add()) {
           msg->trace("added (also) true branch on sexp guard (vector) of branch at", branch);
@@ -909,7 +1032,7 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
         StateWithGuardsTy* state = s.clone(branch->getSuccessor(1));
         if (gs != SGS_SYMBOL && impliesVectorWhenFalse(f)) {
           SEXPGuardTy newGS(SGS_VECTOR);
-          state->sexpGuards[guard] = newGS; // added information from that the true branch was taken
+          state->sexpGuards.set(guard, newGS); // added information from that the true branch was taken
         }
         if (state->add()) {
           msg->trace("added (also) false branch on sexp guard (vector) of branch at", branch);
@@ -942,8 +1065,8 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
     return false;
   }
   
-  std::string guardSymbolName;
-  SEXPGuardState gs = getGuardState(s.sexpGuards, guard, guardSymbolName);
+  SymbolIdTy guardSymbol;
+  SEXPGuardState gs = getGuardState(s.sexpGuards, guard, guardSymbol);
   int succIndex = -1;
 
   if (gv == g->nilVariable) {
@@ -966,7 +1089,7 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
     return false;
   }
       
-  const std::string& constSymbolName = sfind->second;
+  SymbolIdTy constSymbol = sfind->second;
 
   // if (x == R_XSymbol) ...
   // if (x != R_XSymbol) ...
@@ -974,10 +1097,10 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
   if (gs == SGS_SYMBOL) {
     if (ci->isTrueWhenEqual()) {
       // guard == R_XSymbol
-      succIndex = (guardSymbolName == constSymbolName) ? 0 : 1;
+      succIndex = (guardSymbol == constSymbol) ? 0 : 1;
     } else {
       // guard != R_XSymbol
-      succIndex = (guardSymbolName == constSymbolName) ? 1 : 0;
+      succIndex = (guardSymbol == constSymbol) ? 1 : 0;
     }
   }
   if (gs == SGS_NIL || gs == SGS_VECTOR) {  // SGS_NIL and SGS_VECTOR cannot be a symbol
@@ -1009,8 +1132,8 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
     {
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(0));
       if (gs != SGS_SYMBOL && ci->isTrueWhenEqual()) {
-        SEXPGuardTy newGS(SGS_SYMBOL, constSymbolName);
-        state->sexpGuards[guard] = newGS;
+        SEXPGuardTy newGS(SGS_SYMBOL, constSymbol);
+        state->sexpGuards.set(guard, newGS);
       }
       if (state->add()) {
         msg->trace("added true branch on sexp guard of symbol branch at", branch);
@@ -1022,8 +1145,8 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
     {
       StateWithGuardsTy* state = s.clone(branch->getSuccessor(1));
       if (gs != SGS_SYMBOL && ci->isFalseWhenEqual()) {
-        SEXPGuardTy newGS(SGS_SYMBOL, constSymbolName);
-        state->sexpGuards[guard] = newGS;
+        SEXPGuardTy newGS(SGS_SYMBOL, constSymbol);
+        state->sexpGuards.set(guard, newGS);
       }
       if (state->add()) {
         msg->trace("added false branch on sexp guard of branch at", branch);
@@ -1035,94 +1158,75 @@ bool SEXPGuardsChecker::handleForTerminator(TerminatorInst* t, StateWithGuardsTy
   
 PackedSEXPGuardsTy SEXPGuardsChecker::pack(const SEXPGuardsTy& sexpGuards) {
 
-  // note we first have to call indexOf on each variable to make sure
-  // it is indexed [later this should be perhaps done alreading when manipulating guards]
-  
-  for(SEXPGuardsTy::const_iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    varIndex.indexOf(var);
-  }  
-  
-  PackedSEXPGuardsTy packed(varIndex.size());
-  
-  const VarIndexTy::Index& vars = varIndex.getIndex();
-  unsigned idx = 0;
+  if (sexpGuards.symbols.empty()) {
+    return PackedSEXPGuardsTy(sexpGuards.words);
+  }
+
+  // append symbols in the order of variables, so that they can be mapped back
+  SEXPGuardsTy::WordsTy words(sexpGuards.words);
+  unsigned nsymbols = 0;
+  unsigned nvars = varIndex.size();
   
-  // store variables in the order of varIndex, so that symbol names in the list of symbols
-  //   can be mapped back to variables
-  for(VarIndexTy::Index::const_iterator vi = vars.begin(), ve = vars.end(); vi != ve; ++vi, ++idx) {
-    AllocaInst *var = *vi;
-    
-    auto vfind = sexpGuards.find(var);
-    if (vfind == sexpGuards.end()) {
+  for(unsigned idx = 0; idx < nvars; idx++) {
+    SEXPGuardTy g = sexpGuards.getAt(idx);
+    if (g.state != SGS_SYMBOL) {
       continue;
     }
-    const SEXPGuardTy& guard = vfind->second;
-    SEXPGuardState gs = guard.state;
-    
-    unsigned base = idx * SGS_BITS;
-    switch(gs) {
-      case SGS_NIL:    packed.bits[base] = true; break;     // 1 0 0
-      case SGS_NONNIL: packed.bits[base + 1] = true; break; // 0 1 0
-      case SGS_SYMBOL: packed.bits[base] = true; packed.bits[base + 1] = true; // 1 1 0
-                       packed.symbols.push_back(guard.symbolName);
-                       break;
-      case SGS_VECTOR: packed.bits[base + 2] = true; break;     // 0 0 1
-      case SGS_UNKNOWN: break; // 0 0 0
+    if (nsymbols % 2 == 0) {
+      words.push_back(g.symbol);
+    } else {
+      words.back() |= ((uint64_t) g.symbol) << 32;
     }
+    nsymbols++;
   }
-
-  return packed;
+  return PackedSEXPGuardsTy(words);
 }
 
 SEXPGuardsTy SEXPGuardsChecker::unpack(const PackedSEXPGuardsTy& sexpGuards) {
-  SEXPGuardsTy unpacked;
-  unsigned nvars = sexpGuards.bits.size() / SGS_BITS;
+
+  SEXPGuardsTy unpacked(&varIndex);
+  const uint64_t* words = sexpGuards.words.data();
+  unsigned nwords = unpacked.words.size();
   
-  myassert(nvars * SGS_BITS == sexpGuards.bits.size());
-  unsigned symbolIdx = 0;
+  myassert(sexpGuards.words.size() >= nwords);
+  unpacked.words.assign(words, words + nwords);
   
-  for(unsigned idx = 0; idx < nvars; idx++) {
-    unsigned base = idx * SGS_BITS;
-    SEXPGuardState gs = SGS_UNKNOWN;
-    std::string symbolName;
+  if (sexpGuards.words.size() > nwords) {
+    const uint64_t* symbolWords = words + nwords;
+    unsigned nsymbols = 0;
+    unsigned nvars = varIndex.size();
     
-    bool bit2 = sexpGuards.bits[base];
-    bool bit1 = sexpGuards.bits[base + 1];
-    bool bit0 = sexpGuards.bits[base + 2];
-    
-    if (bit2) {
-      if (bit1) {
-        gs = SGS_SYMBOL;
-        symbolName = sexpGuards.symbols[symbolIdx];
-        symbolIdx++;
-      } else {
-        gs = SGS_NIL;
-      }
-    } else {
-      if (bit1) {
-        gs = SGS_NONNIL;
-      } else if (bit0) {
-        gs = SGS_VECTOR;
+    unpacked.symbols.resize(nvars, 0);
+    for(unsigned idx = 0; idx < nvars; idx++) {
+      if (unpacked.FlatGuardsTy::getAt(idx) == SGS_SYMBOL) {
+        uint64_t w = symbolWords[nsymbols / 2];
+        unpacked.symbols[idx] = (SymbolIdTy) ((nsymbols % 2 == 0) ? w : (w >> 32));
+        nsymbols++;
       }
     }
-    
-    if (gs != SGS_UNKNOWN) {
-      unpacked.insert({varIndex.at(idx), SEXPGuardTy(gs, symbolName)});
-    }
   }
+  unpacked.rehash();
   return unpacked;
 }
-  
-void SEXPGuardsChecker::hash(size_t& res, const SEXPGuardsTy& sexpGuards) {
-  hash_combine(res, sexpGuards.size());
-  for(SEXPGuardsTy::const_iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    const SEXPGuardTy& g = gi->second;
-    hash_combine(res, (void *) var);
-    hash_combine(res, (size_t) g.state);
-    hash_combine(res, g.symbolName);
-  } // ordered map
+
+bool SEXPGuardsTy::operator==(const SEXPGuardsTy& other) const {
+
+  if (zobrist != other.zobrist || words != other.words) {
+    return false;
+  }
+  if (symbols.empty() && other.symbols.empty()) {
+    return true;
+  }
+  // symbols are zero for variables not in SGS_SYMBOL state, and may not be allocated at all
+  size_t n = std::max(symbols.size(), other.symbols.size());
+  for(size_t i = 0; i < n; i++) {
+    SymbolIdTy s = (i < symbols.size()) ? symbols[i] : 0;
+    SymbolIdTy os = (i < other.symbols.size()) ? other.symbols[i] : 0;
+    if (s != os) {
+      return false;
+    }
+  }
+  return true;
 }
 
 // common
@@ -1130,25 +1234,34 @@ void SEXPGuardsChecker::hash(size_t& res, const SEXPGuardsTy& sexpGuards) {
 void StateWithGuardsTy::dump(bool verbose) {
   
   errs() << "=== integer guards: " << &intGuards << "\n";
-  for(IntGuardsTy::iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-    AllocaInst *i = gi->first;
-    IntGuardState s = gi->second;
-    errs() << "   " << varName(i) << " ";
-    if (verbose) {
-      errs() << *i << " ";
+  if (intGuards.vars) {
+    for(unsigned idx = 0, nvars = intGuards.vars->size(); idx < nvars; idx++) {
+      IntGuardState s = (IntGuardState) intGuards.getAt(idx);
+      if (s == IGS_UNKNOWN) {
+        continue;
+      }
+      AllocaInst *i = intGuards.vars->at(idx);
+      errs() << "   " << varName(i) << " ";
+      if (verbose) {
+        errs() << *i << " ";
+      }
+      errs() << " state: " << igs_name(s) << "\n";
     }
-    errs() << " state: " << igs_name(s) << "\n";
   }
 
   errs() << "=== sexp guards: " << &sexpGuards << "\n";
-  for(SEXPGuardsTy::iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
-    AllocaInst *i = gi->first;
-    SEXPGuardTy &g = gi->second;
-    
-    errs() << "   " << varName(i) << " ";
-    if (verbose) {
-      errs() << *i << " ";
+  if (sexpGuards.vars) {
+    for(unsigned idx = 0, nvars = sexpGuards.vars->size(); idx < nvars; idx++) {
+      SEXPGuardTy g = sexpGuards.getAt(idx);
+      if (g.state == SGS_UNKNOWN) {
+        continue;
+      }
+      AllocaInst *i = sexpGuards.vars->at(idx);
+      errs() << "   " << varName(i) << " ";
+      if (verbose) {
+        errs() << *i << " ";
+      }
+      errs() << " state: " << sgs_name(g) << "\n";
     }
-    errs() << " state: " << sgs_name(g) << "\n";
-  }  
+  }
 }
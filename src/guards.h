@@ -1,15 +1,18 @@
 #ifndef RCHK_GUARDS_H
 #define RCHK_GUARDS_H
 
+#include <algorithm>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <llvm/IR/Instructions.h>
+#include <llvm/Support/MathExtras.h>
 
 using namespace llvm;
 
-struct SEXPGuardTy; // there is a cyclic dependency between guards.h and vectors.h
-typedef std::map<AllocaInst*,SEXPGuardTy> SEXPGuardsTy;
+struct SEXPGuardsTy; // there is a cyclic dependency between guards.h and vectors.h
 class SEXPGuardsChecker;
 
 #include "common.h"
@@ -18,26 +21,174 @@ class SEXPGuardsChecker;
 #include "state.h"
 #include "symbols.h"
 #include "table.h"
+#include "vartable.h"
 #include "vectors.h"
 
+#include <cstdint>
+#include <cstring>
+
+typedef IndexedTable<AllocaInst> GuardVarIndexTy; // index of guard variables of a function
+typedef std::unordered_map<BasicBlock*, std::vector<uint64_t>> GuardMasksTy; // block -> set of guards (in the layout of FlatGuardsTy)
+
+// states of all guard variables of a function, kept in a flat array of words,
+//   BITS bits per variable (a variable never spans two words)
+//
+// the guard variables are indexed eagerly by the guard checker (reset) and the
+//   index is shared by all states of the function; zero bits mean unknown state
+//
+// the hash is maintained incrementally (Zobrist-style): it is the XOR of
+//   hashes of the guards in a known state, updated whenever a guard is set
+
+template <unsigned BITS> struct FlatGuardsTy {
+
+  typedef uint64_t WordTy;
+  typedef std::vector<WordTy> WordsTy;
+  
+  static const unsigned VARS_PER_WORD = 64 / BITS;
+  static const WordTy VAR_MASK = (((WordTy) 1) << BITS) - 1;
+
+  const GuardVarIndexTy* vars; // owned by the checker
+  WordsTy words;
+  uint64_t zobrist;
+  
+  FlatGuardsTy(const GuardVarIndexTy* vars): vars(vars), words((vars->size() + VARS_PER_WORD - 1) / VARS_PER_WORD, 0), zobrist(0) {};
+  FlatGuardsTy(): vars(NULL), words(), zobrist(0) {};
+  
+  // extra distinguishes guards in the same state (e.g. the symbol)
+  static uint64_t guardHash(unsigned idx, unsigned value, uint64_t extra = 0) {
+    return value ? mix_bits((extra << 32) ^ (((uint64_t) idx) << BITS) ^ value) : 0;
+  }
+  
+  unsigned getAt(unsigned idx) const {
+    return (words[idx / VARS_PER_WORD] >> ((idx % VARS_PER_WORD) * BITS)) & VAR_MASK;
+  }
+  
+  void setBits(unsigned idx, unsigned value) { // does not update the hash
+    WordTy& w = words[idx / VARS_PER_WORD];
+    unsigned shift = (idx % VARS_PER_WORD) * BITS;
+    w = (w & ~(VAR_MASK << shift)) | (((WordTy) value) << shift);
+  }
+  
+  void setAt(unsigned idx, unsigned value) {
+    zobrist ^= guardHash(idx, getAt(idx)) ^ guardHash(idx, value);
+    setBits(idx, value);
+  }
+  
+  void clear() { // all guards unknown
+    std::fill(words.begin(), words.end(), 0);
+    zobrist = 0;
+  }
+  
+  void rehash() { // after the words have been set directly
+    zobrist = 0;
+    for(unsigned idx = 0, nvars = vars->size(); idx < nvars; idx++) {
+      zobrist ^= guardHash(idx, getAt(idx));
+    }
+  }
+  
+  bool indexOf(AllocaInst* var, unsigned& idx) const {
+    return vars && vars->find(var, idx);
+  }
+  
+  // calls f(idx) for known guards not in mask (a set of guards in the layout of words)
+  template <class F> void forEachKnownNotIn(const WordsTy& mask, F f) const {
+    for(unsigned w = 0, nwords = words.size(); w < nwords; w++) {
+      WordTy dropped = words[w] & ~mask[w];
+      while (dropped) {
+        unsigned slot = countTrailingZeros(dropped) / BITS;
+        f(w * VARS_PER_WORD + slot);
+        dropped &= ~(VAR_MASK << (slot * BITS));
+      }
+    }
+  }
+  
+  bool operator==(const FlatGuardsTy& other) const { return zobrist == other.zobrist && words == other.words; }; // same vars
+  
+  void hash(size_t& res) const {
+    hash_combine(res, zobrist);
+  }
+};
+
+// packed guard state of a done-set entry, a run of words stored inline
+//   when it fits (almost always, as functions have few guard variables)
+
+class PackedWordsTy {
+
+  typedef uint64_t WordTy;
+  static const unsigned INLINE_WORDS = 2;
+
+  unsigned nwords;
+  union {
+    WordTy inlineWords[INLINE_WORDS];
+    WordTy* heapWords;
+  };
+  
+  void init(const WordTy* src, unsigned n) {
+    nwords = n;
+    WordTy* dst = inlineWords;
+    if (n > INLINE_WORDS) {
+      heapWords = new WordTy[n];
+      dst = heapWords;
+    }
+    if (n) {
+      memcpy(dst, src, n * sizeof(WordTy));
+    }
+  }
+  
+  public:
+    PackedWordsTy(const WordTy* src, unsigned n) { init(src, n); }
+    PackedWordsTy(const PackedWordsTy& other) { init(other.data(), other.nwords); }
+    PackedWordsTy& operator=(const PackedWordsTy& other) = delete;
+    ~PackedWordsTy() { if (nwords > INLINE_WORDS) delete[] heapWords; }
+    
+    const WordTy* data() const { return (nwords > INLINE_WORDS) ? heapWords : inlineWords; }
+    WordTy* data() { return (nwords > INLINE_WORDS) ? heapWords : inlineWords; }
+    unsigned size() const { return nwords; }
+    
+    bool operator==(const PackedWordsTy& other) const {
+      return nwords == other.nwords && !memcmp(data(), other.data(), nwords * sizeof(WordTy));
+    }
+};
+
 // integer variable used as a guard
 
 enum IntGuardState {
-  IGS_ZERO = 0,
-  IGS_NONZERO,
-  IGS_UNKNOWN
+  IGS_UNKNOWN = 0,
+  IGS_ZERO,
+  IGS_NONZERO
 };
 const unsigned IGS_BITS = 2;
 
-typedef std::map<AllocaInst*,IntGuardState> IntGuardsTy;
+struct IntGuardsTy : public FlatGuardsTy<IGS_BITS> {
+
+  IntGuardsTy(const GuardVarIndexTy* vars): FlatGuardsTy(vars) {};
+  IntGuardsTy(): FlatGuardsTy() {};
+  
+  IntGuardState get(AllocaInst* var) const {
+    unsigned idx;
+    return indexOf(var, idx) ? (IntGuardState) getAt(idx) : IGS_UNKNOWN;
+  }
+  
+  void set(AllocaInst* var, IntGuardState gs) {
+    unsigned idx;
+    bool found = indexOf(var, idx); // only variables indexed by the checker have a state
+    myassert(found);
+    if (found) {
+      setAt(idx, gs);
+    }
+  }
+  
+  void retain(const WordsTy& mask) { // forget the guards not in mask
+    forEachKnownNotIn(mask, [this](unsigned idx) { setAt(idx, IGS_UNKNOWN); });
+  }
+};
 
 struct PackedIntGuardsTy {
 
-  typedef std::vector<bool> BitsTy;
-  BitsTy bits;
+  PackedWordsTy words;
   
-  PackedIntGuardsTy(unsigned nvars) : bits(nvars * IGS_BITS) {};
-  bool operator==(const PackedIntGuardsTy& other) const { return bits == other.bits; };
+  PackedIntGuardsTy(const IntGuardsTy::WordsTy& words) : words(words.data(), words.size()) {};
+  bool operator==(const PackedIntGuardsTy& other) const { return words == other.words; };
 };
 
 struct StateWithGuardsTy;
@@ -47,65 +198,122 @@ std::string igs_name(IntGuardState igs);
 // per-function state for checking SEXP guards
 class IntGuardsChecker {
 
-  typedef IndexedTable<AllocaInst> VarIndexTy; // index of guard variables known so far
-
-  VarIndexTy varIndex;
-  VarBoolCacheTy varsCache; // FIXME: could eagerly search all variables and merge var cache with index
+  GuardVarIndexTy varIndex; // all guard variables of the function
+  GuardMasksTy liveGuards; // guards possibly read later, at the start of each block
+  std::vector<bool> droppedGuards; // by guard index
   LineMessenger* msg;
 
   public:
-    IntGuardsChecker(LineMessenger* msg): varIndex(), varsCache(), msg(msg) {};
+    IntGuardsChecker(LineMessenger* msg): varIndex(), liveGuards(), droppedGuards(), msg(msg) {};
 
     PackedIntGuardsTy pack(const IntGuardsTy& intGuards);
     IntGuardsTy unpack(const PackedIntGuardsTy& intGuards);
-    void hash(size_t& res, const IntGuardsTy& intGuards);
 
     bool isGuard(AllocaInst* var);
     void handleForNonTerminator(Instruction* in, IntGuardsTy& intGuards);
     bool handleForTerminator(TerminatorInst* t, StateWithGuardsTy& s);
+    AllocaInst* getBranchGuard(TerminatorInst* t); // the guard t branches on, if any
     
     IntGuardState getGuardState(const IntGuardsTy& intGuards, AllocaInst* var);
+    IntGuardsTy emptyGuards() { return IntGuardsTy(&varIndex); } // all guards unknown
+    void forgetDeadGuards(BasicBlock *bb, IntGuardsTy& intGuards) const; // for a state at the start of bb
+
+    unsigned getNGuards() const { return varIndex.size(); }
+    AllocaInst* getGuardVar(unsigned idx) const { return varIndex.at(idx); }
+    bool dropGuard(unsigned idx); // forget the guard at the start of each block from now on, false if already dropped
 
-    void reset(Function *f) {};    
-    void clear() { varsCache.clear(); } // FIXME: get rid of this
+    void reset(Function *f, VarTableTy& vars); // indexes guard variables of f, vars must be reset for f
 };
 
 
 // SEXP - an "R pointer" used as a guard
 
 enum SEXPGuardState {
-  SGS_NIL = 0, // R_NilValue
-  SGS_SYMBOL,  // A specific symbol, name stored in symbolName
+  SGS_UNKNOWN = 0,
+  SGS_NIL,     // R_NilValue
+  SGS_SYMBOL,  // A specific symbol, (interned) name stored in symbol
   SGS_VECTOR,  // Anything that LENGTH can be called on (includes numeric vectors, generic vectors, but not things implemented as pair-lists) 
-  SGS_NONNIL,
-  SGS_UNKNOWN
+  SGS_NONNIL
 };
 const unsigned SGS_BITS = 3;
 
 struct SEXPGuardTy {
   SEXPGuardState state;
-  std::string symbolName;
+  SymbolIdTy symbol; // only valid for SGS_SYMBOL
   
-  SEXPGuardTy(SEXPGuardState state, const std::string& symbolName): state(state), symbolName(symbolName) {}
-  SEXPGuardTy(SEXPGuardState state): state(state), symbolName() { assert(state != SGS_SYMBOL); }
+  SEXPGuardTy(SEXPGuardState state, SymbolIdTy symbol): state(state), symbol(symbol) {}
+  SEXPGuardTy(SEXPGuardState state): state(state), symbol(0) { assert(state != SGS_SYMBOL); }
   SEXPGuardTy() : SEXPGuardTy(SGS_UNKNOWN) {};
   
-  bool operator==(const SEXPGuardTy& other) const { return state == other.state && (state != SGS_SYMBOL || symbolName == other.symbolName); };
+  bool operator==(const SEXPGuardTy& other) const { return state == other.state && (state != SGS_SYMBOL || symbol == other.symbol); };
   
 };
 
+struct SEXPGuardsTy : public FlatGuardsTy<SGS_BITS> {
 
+  typedef std::vector<SymbolIdTy> SymbolsTy;
+  SymbolsTy symbols; // indexed by variable, allocated when the first symbol is stored, zero unless SGS_SYMBOL
+
+  SEXPGuardsTy(const GuardVarIndexTy* vars): FlatGuardsTy(vars), symbols() {};
+  SEXPGuardsTy(): FlatGuardsTy(), symbols() {};
+  
+  SEXPGuardTy getAt(unsigned idx) const {
+    SEXPGuardState gs = (SEXPGuardState) FlatGuardsTy::getAt(idx);
+    return SEXPGuardTy(gs, gs == SGS_SYMBOL ? symbols[idx] : 0);
+  }
+  
+  void setAt(unsigned idx, const SEXPGuardTy& g) {
+    SEXPGuardTy old = getAt(idx);
+    zobrist ^= guardHash(idx, old.state, old.symbol) ^ guardHash(idx, g.state, g.state == SGS_SYMBOL ? g.symbol : 0);
+    setBits(idx, g.state);
+    if (g.state == SGS_SYMBOL && symbols.empty()) {
+      symbols.resize(vars->size(), 0);
+    }
+    if (!symbols.empty()) {
+      symbols[idx] = (g.state == SGS_SYMBOL) ? g.symbol : 0;
+    }
+  }
+  
+  SEXPGuardTy get(AllocaInst* var) const {
+    unsigned idx;
+    return indexOf(var, idx) ? getAt(idx) : SEXPGuardTy();
+  }
+
+  void set(AllocaInst* var, const SEXPGuardTy& g) {
+    unsigned idx;
+    bool found = indexOf(var, idx); // only variables indexed by the checker have a state
+    myassert(found);
+    if (found) {
+      setAt(idx, g);
+    }
+  }
+  
+  void retain(const WordsTy& mask) { // forget the guards not in mask
+    forEachKnownNotIn(mask, [this](unsigned idx) { setAt(idx, SEXPGuardTy()); });
+  }
+  
+  void clear() { // all guards unknown
+    FlatGuardsTy::clear();
+    symbols.clear();
+  }
+  
+  void rehash() { // after the words and symbols have been set directly
+    zobrist = 0;
+    for(unsigned idx = 0, nvars = vars->size(); idx < nvars; idx++) {
+      SEXPGuardTy g = getAt(idx);
+      zobrist ^= guardHash(idx, g.state, g.symbol);
+    }
+  }
+  
+  bool operator==(const SEXPGuardsTy& other) const;
+};
 
 struct PackedSEXPGuardsTy {
 
-  typedef std::vector<bool> BitsTy;
-  BitsTy bits;
+  PackedWordsTy words; // guard state words, followed by symbols of SGS_SYMBOL variables (two per word, in the order of variables)
   
-  typedef std::vector<std::string> SymbolsTy;
-  SymbolsTy symbols;
-  
-  PackedSEXPGuardsTy(unsigned nvars) : bits(nvars * SGS_BITS), symbols() {};
-  bool operator==(const PackedSEXPGuardsTy& other) const { return bits == other.bits && symbols == other.symbols; };
+  PackedSEXPGuardsTy(const SEXPGuardsTy::WordsTy& words) : words(words.data(), words.size()) {};
+  bool operator==(const PackedSEXPGuardsTy& other) const { return words == other.words; };
 };
 
   // yikes, need forward type-def
@@ -115,47 +323,53 @@ typedef std::vector<const ArgInfoTy*> ArgInfosVectorTy;
 // per-function state for checking SEXP guards
 class SEXPGuardsChecker {
 
-  typedef IndexedTable<AllocaInst> VarIndexTy; // index of guard variables known so far
-
-  VarIndexTy varIndex;
-  VarBoolCacheTy varsCache; // FIXME: could eagerly search all variables and merge var cache with index
+  GuardVarIndexTy varIndex; // all guard variables of the function, followed by other variables with a state
+  GuardMasksTy liveGuards; // variables with a state possibly read later, at the start of each block
+  std::vector<bool> droppedGuards; // by variable index
+  unsigned nGuards;
   LineMessenger* msg;
   const GlobalsTy* g;
-  const FunctionsSetTy* possibleAllocators;
+  const FunctionsBitsTy* possibleAllocators; // by function id
   const SymbolsMapTy* symbolsMap;
   const ArgInfosVectorTy* argInfos;
   VrfStateTy* vrfState;
   CalledModuleTy* cm; // FIXME: get rid of fields that are already in called module anyway
   
   public:
-    SEXPGuardsChecker(LineMessenger* msg, const GlobalsTy* g, const FunctionsSetTy* possibleAllocators, const SymbolsMapTy* symbolsMap, const ArgInfosVectorTy* argInfos,
+    SEXPGuardsChecker(LineMessenger* msg, const GlobalsTy* g, const FunctionsBitsTy* possibleAllocators, const SymbolsMapTy* symbolsMap, const ArgInfosVectorTy* argInfos,
       VrfStateTy* vrfState, CalledModuleTy* cm):
-      varIndex(), varsCache(), msg(msg), g(g), possibleAllocators(possibleAllocators), symbolsMap(symbolsMap), argInfos(argInfos), vrfState(vrfState), cm(cm) {};
+      varIndex(), liveGuards(), droppedGuards(), nGuards(0), msg(msg), g(g), possibleAllocators(possibleAllocators), symbolsMap(symbolsMap), argInfos(argInfos), vrfState(vrfState), cm(cm) {};
 
     PackedSEXPGuardsTy pack(const SEXPGuardsTy& sexpGuards);
     SEXPGuardsTy unpack(const PackedSEXPGuardsTy& sexpGuards);
-    void hash(size_t& res, const SEXPGuardsTy& sexpGuards);
 
     bool isGuard(AllocaInst* var);
-    void handleForNonTerminator(Instruction* in, SEXPGuardsTy& sexpGuards);
+    void handleForNonTerminator(Instruction* in, SEXPGuardsTy& sexpGuards, unsigned storedFunId);
+      // storedFunId is storedCallTargetId(in), resolved once per function by the caller
     bool handleForTerminator(TerminatorInst* t, StateWithGuardsTy& s);
     
     SEXPGuardState getGuardState(const SEXPGuardsTy& sexpGuards, AllocaInst* var);
-    SEXPGuardState getGuardState(const SEXPGuardsTy& sexpGuards, AllocaInst* var, std::string& symbolName);
+    SEXPGuardState getGuardState(const SEXPGuardsTy& sexpGuards, AllocaInst* var, SymbolIdTy& symbol);
+    SEXPGuardsTy emptyGuards() { return SEXPGuardsTy(&varIndex); } // all guards unknown
+    void forgetDeadGuards(BasicBlock *bb, SEXPGuardsTy& sexpGuards) const; // for a state at the start of bb
+
+    unsigned getNGuards() const { return nGuards; } // the guards come first in the index
+    AllocaInst* getGuardVar(unsigned idx) const { return varIndex.at(idx); }
+    bool dropGuard(unsigned idx); // forget the guard at the start of each block from now on, false if already dropped
 
-    void reset(Function *f) {};    
-    void clear() { varsCache.clear(); } // FIXME: get rid of this
+    void reset(Function *f, VarTableTy& vars); // indexes guard variables of f, vars must be reset for f
     
     VrfStateTy* getVrfState() { return vrfState; }
     
   private:
-    bool uncachedIsGuard(AllocaInst* var);
+    bool isGuardVariable(AllocaInst* var);
     bool handleNullCheck(bool positive, SEXPGuardState gs, AllocaInst *guard, BranchInst* branch, StateWithGuardsTy& s);
     bool handleTypeCheck(bool positive, int testedType, SEXPGuardState gs, AllocaInst *guard, BranchInst* branch, StateWithGuardsTy& s);
     bool handleTypeSwitch(TerminatorInst* t, StateWithGuardsTy& s);
 };
 
 std::string sgs_name(SEXPGuardState sgs);
+unsigned storedCallTargetId(Instruction* in, CalledModuleTy* cm); // id of the function whose call result in stores, FunctionIdsTy::NONE if none
 
 // checking state with guards
 
@@ -164,7 +378,6 @@ struct StateWithGuardsTy : virtual public StateBaseTy {
   SEXPGuardsTy sexpGuards;
   
   StateWithGuardsTy(BasicBlock *bb, const IntGuardsTy& intGuards, const SEXPGuardsTy& sexpGuards): StateBaseTy(bb), intGuards(intGuards), sexpGuards(sexpGuards) {};
-  StateWithGuardsTy(BasicBlock *bb): StateBaseTy(bb), intGuards(), sexpGuards() {};
   
   virtual StateWithGuardsTy* clone(BasicBlock *newBB) = 0;
   
@@ -23,10 +23,12 @@ void BaseLineMessenger::debug(const std::string& msg, Instruction *in) {
 }
 
 void BaseLineMessenger::info(const std::string& msg, Instruction *in) {
+  nReported++;
   emit(_DEBUG ? "INFO" : "", withTrace(msg, in), in);
 }
 
 void BaseLineMessenger::error(const std::string& msg, Instruction *in) {
+  nReported++;
   emit("ERROR", withTrace(msg, in), in);
 }
 
@@ -94,8 +96,12 @@ void LineMessenger::flush() {
       const LineInfoTy* li = *liBuf;
       li->print();
     }
+    nKept += lineBuffer.size();
     lineBuffer.clear();
   }
+  nKept += nPending;
+  nPending = 0;
+  delayedSetsTable.clear(); // refers to the interned messages
   internTable.clear();
   lastFunction = NULL;
 }
@@ -103,6 +109,9 @@ void LineMessenger::flush() {
 void LineMessenger::newFunction(Function *func, const std::string& checksName) {
   if (!UNIQUE_MSG) {
     outs() << "\nFunction " << funName(func) << checksName << "\n";
+    delayedSetsTable.clear();
+    nKept += nPending;
+    nPending = 0;
   } else {
     flush();
   }
@@ -113,6 +122,7 @@ void LineMessenger::newFunction(Function *func, const std::string& checksName) {
 void LineMessenger::emitInterned(const LineInfoTy* li) {
   if (!UNIQUE_MSG) {
     li->print();
+    nPending++;
   } else {
     lineBuffer.insert(li);
   }
@@ -129,33 +139,72 @@ const LineInfoTy* LineMessenger::intern(const LineInfoTy& li) {
 void LineMessenger::clear() {
   if (!UNIQUE_MSG) {
     outs() << " ---- restarting checking for function " << funName(lastFunction) << " (previous messages for it to be ignored) ----\n";
+    nPending = 0;
   } else {
     lineBuffer.clear();
     // not clearing the intern table
   }
 }
 
+void LineMessenger::clear(const std::string& checksName) {
+  clear();
+  if (!UNIQUE_MSG) {
+    outs() << "\nFunction " << funName(lastFunction) << checksName << "\n";
+  }
+  lastChecksName = checksName;
+}
+
 // ----------------------------- 
 
 void DelayedLineMessenger::emit(const LineInfoTy *li) {
-  delayedLineBuffer.insert(msg->intern(*li));
+  messages = msg->addToDelayedSet(messages, li);
 }
 
 void DelayedLineMessenger::flush() {
-  for(LineInfoPtrSetTy::const_iterator bi = delayedLineBuffer.begin(), be = delayedLineBuffer.end(); bi != be; ++bi) {
+  for(LineInfoPtrSetTy::const_iterator bi = messages->begin(), be = messages->end(); bi != be; ++bi) {
     msg->emitInterned(*bi);
   }
-  delayedLineBuffer.clear();
+  messages = msg->emptyDelayedSet();
 }
 
-void DelayedLineMessenger::print(const std::string& prefix) {
-  for(LineInfoPtrSetTy::const_iterator bi = delayedLineBuffer.begin(), be = delayedLineBuffer.end(); bi != be; ++bi) {
+void printDelayedMessages(const LineInfoPtrSetTy* messages, const std::string& prefix) {
+  for(LineInfoPtrSetTy::const_iterator bi = messages->begin(), be = messages->end(); bi != be; ++bi) {
     const LineInfoTy *li = *bi;
     outs() << prefix;
     li->print();
   }
 }
 
-bool DelayedLineMessenger::operator==(const DelayedLineMessenger& other) const {
-  return delayedLineBuffer == other.delayedLineBuffer && msg == other.msg;
+// ----------------------------- 
+
+size_t LineInfoPtrSetTy_hash::operator()(const LineInfoPtrSetTy& t) const {
+  size_t res = 0;
+  hash_combine(res, t.size());
+  for(LineInfoPtrSetTy::const_iterator li = t.begin(), le = t.end(); li != le; ++li) {
+    hash_combine(res, (const void *) *li);
+  }
+  return res;
+}
+
+const LineInfoPtrSetTy* LineInfoSetsTableTy::add(const LineInfoPtrSetTy* set, const LineInfoTy* li) {
+  UnionKeyTy key(set, li);
+  auto usearch = unions.find(key);
+  if (usearch != unions.end()) {
+    return usearch->second;
+  }
+  
+  const LineInfoPtrSetTy* res = set;
+  if (set->find(li) == set->end()) {
+    LineInfoPtrSetTy extended(*set);
+    extended.insert(li);
+    res = sets.intern(extended);
+  }
+  unions.insert({key, res});
+  return res;
+}
+
+void LineInfoSetsTableTy::clear() {
+  unions.clear();
+  sets.clear();
+  emptySet = sets.intern(LineInfoPtrSetTy());
 }
@@ -47,18 +47,54 @@ struct LineInfoTy_equal {
 typedef std::set<const LineInfoTy*, LineInfoTyPtr_compare> LineInfoPtrSetTy; // for ordering messages, uniqueness
 typedef InterningTable<LineInfoTy, LineInfoTy_hash, LineInfoTy_equal> LineInfoTableTy; // for interning table (performance)
 
+struct LineInfoPtrSetTy_hash {
+  size_t operator()(const LineInfoPtrSetTy& t) const;
+};
+
+// interned sets of interned messages (for delayed messages, which are part of checking states)
+//   extending a set by a message is cached, so repeated additions cost a hash lookup
+
+class LineInfoSetsTableTy {
+
+  typedef InterningTable<LineInfoPtrSetTy, LineInfoPtrSetTy_hash> SetsTableTy;
+  typedef std::pair<const LineInfoPtrSetTy*, const LineInfoTy*> UnionKeyTy;
+  
+  struct UnionKeyTy_hash {
+    size_t operator()(const UnionKeyTy& t) const {
+      size_t res = 0;
+      hash_combine(res, t.first);
+      hash_combine(res, t.second);
+      return res;
+    }
+  };
+  typedef std::unordered_map<UnionKeyTy, const LineInfoPtrSetTy*, UnionKeyTy_hash> UnionsTy;
+
+  SetsTableTy sets;
+  UnionsTy unions;
+  const LineInfoPtrSetTy* emptySet;
+  
+  public:
+    LineInfoSetsTableTy(): sets(), unions(), emptySet(sets.intern(LineInfoPtrSetTy())) {};
+    
+    const LineInfoPtrSetTy* empty() const { return emptySet; }
+    const LineInfoPtrSetTy* add(const LineInfoPtrSetTy* set, const LineInfoTy* li); // li has to be interned
+    void clear();
+    size_t memoryUsage() const { return sets.memoryUsage(); }
+};
+
 class BaseLineMessenger {
 
   protected:
     bool _DEBUG;
     bool TRACE;
     const bool UNIQUE_MSG;
+    unsigned long nReported; // info and error messages
     
     std::string withTrace(const std::string& msg, Instruction *in) const;
   
   public:
     BaseLineMessenger(bool _DEBUG, bool TRACE, bool UNIQUE_MSG):
-      _DEBUG(_DEBUG), TRACE(TRACE), UNIQUE_MSG(UNIQUE_MSG) {};
+      _DEBUG(_DEBUG), TRACE(TRACE), UNIQUE_MSG(UNIQUE_MSG), nReported(0) {};
       
     void trace(const std::string& msg, Instruction *in);
     void debug(const std::string& msg, Instruction *in);
@@ -69,6 +105,7 @@ class BaseLineMessenger {
     void debug(bool v) { _DEBUG = v; }
     void trace(bool v) { TRACE = v; }
     bool uniqueMsg() const { return UNIQUE_MSG; }
+    unsigned long getNReported() const { return nReported; } // info and error messages, including those cleared later
     
     void emit(const std::string& kind, const std::string& message, Instruction *in);
     virtual void emit(const LineInfoTy* li) = 0;
@@ -82,23 +119,31 @@ class LineMessenger : public BaseLineMessenger {
     // the interning is important for the DelayedLineMessenger
     //   for printing messages directly with LineMessenger, one could easily
     //   do without it
+  LineInfoSetsTableTy delayedSetsTable; // sets of delayed messages, per function
   
   Function *lastFunction;
   std::string lastChecksName;
+  unsigned long nPending; // messages printed for the current function since the last restart (without UNIQUE_MSG)
+  unsigned long nKept; // messages of earlier functions, not cleared by a restart
 //  const LLVMContext& context;
   
   public:
     LineMessenger(LLVMContext& context, bool _DEBUG, bool TRACE, bool UNIQUE_MSG):
-      BaseLineMessenger(_DEBUG, TRACE, UNIQUE_MSG), lineBuffer(), internTable(), lastFunction(NULL), lastChecksName() {};
+      BaseLineMessenger(_DEBUG, TRACE, UNIQUE_MSG), lineBuffer(), internTable(), delayedSetsTable(), lastFunction(NULL), lastChecksName(), nPending(0), nKept(0) {};
 //      BaseLineMessenger(_DEBUG, TRACE, UNIQUE_MSG), lineBuffer(), internTable(), lastFunction(NULL), lastChecksName(), context(context)  {};
       
     void flush();
     void clear();
+    void clear(const std::string& checksName); // also changes the name of the checks for the following messages
     void newFunction(Function *func, const std::string& checksName);
     void newFunction(Function *func) { newFunction(func, ""); }
     
     const LineInfoTy* intern(const LineInfoTy& li); // intern (but do not emit)
     void emitInterned(const LineInfoTy* li); // emit line info interned in internTable
+    unsigned long getNKept() const { return nKept; } // the current function is counted when flushed
+    size_t tablesMemoryUsage() const { return internTable.memoryUsage() + delayedSetsTable.memoryUsage(); }
+    const LineInfoPtrSetTy* emptyDelayedSet() const { return delayedSetsTable.empty(); }
+    const LineInfoPtrSetTy* addToDelayedSet(const LineInfoPtrSetTy* set, const LineInfoTy* li) { return delayedSetsTable.add(set, intern(*li)); }
     
     virtual void emit(const LineInfoTy* li);
 };
@@ -107,25 +152,26 @@ class LineMessenger : public BaseLineMessenger {
 //   it remembers messages, preparing them for being printed via LineMessenger msg,
 //   but only prints them if/when flush() is called
 //
-// the messages are interned immediatelly with LineMessenger msg (which is
-//   for performance of comparisons and for reducing the memory costs, because delayed
-//   messengers are indeed part of the checking state
+// the messages are interned immediatelly with LineMessenger msg, and so is the
+//   set of messages (which is for performance of comparisons and for reducing the
+//   memory costs, because the sets of delayed messages are indeed part of the
+//   checking state); the interned sets are valid until the next function
 
 struct DelayedLineMessenger : public BaseLineMessenger {
 
   LineMessenger* const msg; // used to print messages (flush) and to intern them
-  LineInfoPtrSetTy delayedLineBuffer; // for interned messages
-    // it would not have to be ordered for correctness, but note that the speed of comparison of delayedLineBuffers
-    // is more important than the speed of inserting into the buffer
+  const LineInfoPtrSetTy* messages; // interned set of interned messages
+    // it would not have to be ordered for correctness, but it is hashed for interning
     
-  DelayedLineMessenger(LineMessenger *msg):
-    BaseLineMessenger(msg->debug(), msg->trace(), msg->uniqueMsg()), msg(msg), delayedLineBuffer() {};
+  DelayedLineMessenger(LineMessenger *msg, const LineInfoPtrSetTy* messages):
+    BaseLineMessenger(msg->debug(), msg->trace(), msg->uniqueMsg()), msg(msg), messages(messages) {};
+  DelayedLineMessenger(LineMessenger *msg): DelayedLineMessenger(msg, msg->emptyDelayedSet()) {};
       
   void flush();
-  bool operator==(const DelayedLineMessenger& other) const;
   virtual void emit(const LineInfoTy* li);
-  size_t size() const { return delayedLineBuffer.size(); }
-  void print(const std::string& prefix);
+  size_t size() const { return messages->size(); }
 };
 
+void printDelayedMessages(const LineInfoPtrSetTy* messages, const std::string& prefix);
+
 #endif
@@ -27,6 +27,7 @@
 
 #include "allocators.h"
 #include "cgclosure.h"
+#include "prefilter.h"
 
 using namespace llvm;
 
@@ -78,12 +79,18 @@ int main(int argc, char* argv[])
   FunctionsSetTy possibleAllocators;
   findPossibleAllocators(m, possibleAllocators); // FIXME: use context-sensitive (more precise) detection
 
+  GlobalsTy gl(m);
+
   for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
 
     auto fisearch = functionsMap.find(*FI);
     myassert (fisearch != functionsMap.end());
     FunctionInfo& finfo = fisearch->second;
 
+    if (isTriviallyCleanForArguments(functionTraits(*FI, gl, possibleAllocators, NULL))) {
+      continue;
+    }
+
     for(std::vector<CallInfo>::const_iterator CI = finfo.callInfos.begin(), CE = finfo.callInfos.end(); CI != CE; ++CI) {
       const CallInfo& cinfo = *CI;
         
@@ -0,0 +1,55 @@
+
+#include "prefilter.h"
+
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+
+using namespace llvm;
+
+unsigned functionTraits(Function *f, const GlobalsTy& g, const FunctionsSetTy& possibleAllocators, const FunctionsSetTy* allocatingFunctions) {
+
+  unsigned traits = 0;
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    Instruction *in = &*ii;
+
+    if (AllocaInst *var = dyn_cast<AllocaInst>(in)) {
+      if (isSEXP(var)) {
+        traits |= FT_SEXP_VARS;
+      }
+      continue;
+    }
+    if (LoadInst *li = dyn_cast<LoadInst>(in)) {
+      if (li->getPointerOperand() == g.ppStackTopVariable) {
+        traits |= FT_PROTECTION;
+      }
+      continue;
+    }
+    if (StoreInst *si = dyn_cast<StoreInst>(in)) {
+      if (si->getPointerOperand() == g.ppStackTopVariable) {
+        traits |= FT_PROTECTION;
+      }
+      continue;
+    }
+
+    CallSite cs(in);
+    if (!cs) {
+      continue;
+    }
+    Function *tgt = cs.getCalledFunction();
+    if (!tgt) {
+      traits |= FT_ALLOCATING_CALLS;
+      continue;
+    }
+    if (tgt == g.protectFunction || tgt == g.protectWithIndexFunction || tgt == g.unprotectFunction || tgt == g.unprotectPtrFunction) {
+      traits |= FT_PROTECTION;
+    }
+    if (!allocatingFunctions || allocatingFunctions->find(tgt) != allocatingFunctions->end()) {
+      traits |= FT_ALLOCATING_CALLS;
+    }
+    if (possibleAllocators.find(tgt) != possibleAllocators.end()) {
+      traits |= FT_ALLOCATOR_CALLS;
+    }
+  }
+  return traits;
+}
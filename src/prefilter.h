@@ -0,0 +1,30 @@
+#ifndef RCHK_PREFILTER_H
+#define RCHK_PREFILTER_H
+
+#include "common.h"
+
+#include <llvm/IR/Function.h>
+
+using namespace llvm;
+
+// a syntactic classification of a function (one pass over its
+//   instructions), so that checkers can skip functions they have nothing
+//   to check in before any per-function setup
+
+enum FunctionTrait {
+  FT_SEXP_VARS = 1 << 0,	// has a local variable of type SEXP
+  FT_PROTECTION = 1 << 1,	// calls PROTECT/UNPROTECT or accesses R_PPStackTop
+  FT_ALLOCATING_CALLS = 1 << 2,	// calls an allocating function (or a function not known)
+  FT_ALLOCATOR_CALLS = 1 << 3	// calls a possible allocator (may get a fresh object)
+};
+
+// allocatingFunctions may be NULL, then all calls are taken as allocating
+unsigned functionTraits(Function *f, const GlobalsTy& g, const FunctionsSetTy& possibleAllocators, const FunctionsSetTy* allocatingFunctions);
+
+// bcheck: no protection to balance, and no allocation a fresh object could be exposed to
+inline bool isTriviallyCleanForBalance(unsigned traits) { return !(traits & (FT_SEXP_VARS | FT_PROTECTION | FT_ALLOCATING_CALLS)); }
+
+// maacheck, ueacheck: no argument can be a fresh object
+inline bool isTriviallyCleanForArguments(unsigned traits) { return !(traits & FT_ALLOCATOR_CALLS); }
+
+#endif
@@ -1,5 +1,6 @@
 
 #include "symbols.h"
+#include "table.h"
 
 using namespace llvm;
 
@@ -13,6 +14,22 @@ using namespace llvm;
 
 #include <llvm/Support/raw_ostream.h>
 
+typedef IndexedCopyingTable<std::string> SymbolsTableTy;
+
+static SymbolsTableTy symbolsTable; // module-wide table of interned symbol names
+
+SymbolIdTy internSymbol(const std::string& symbolName) {
+  return symbolsTable.indexOf(symbolName);
+}
+
+std::string getSymbolName(SymbolIdTy symbol) {
+  return symbolsTable.getIndex().at(symbol);
+}
+
+size_t symbolsMemoryUsage() {
+  return symbolsTable.memoryUsage();
+}
+
 bool isInstallConstantCall(Value *inst, std::string& symbolName) {
   CallSite cs(inst);
   if (!cs) {
@@ -52,6 +69,15 @@ bool isInstallConstantCall(Value *inst, std::string& symbolName) {
   return true;   
 }
 
+bool isInstallConstantCall(Value *inst, SymbolIdTy& symbol) {
+  std::string symbolName;
+  if (!isInstallConstantCall(inst, symbolName)) {
+    return false;
+  }
+  symbol = internSymbol(symbolName);
+  return true;
+}
+
 void findSymbols(Module *m, SymbolsMapTy* symbolsMap) {
 
   for(Module::global_iterator gi = m->global_begin(), ge = m->global_end(); gi != ge ; ++gi) {
@@ -91,7 +117,7 @@ void findSymbols(Module *m, SymbolsMapTy* symbolsMap) {
       }
     }
     if (foundInstall) {
-      symbolsMap->insert({gv, symbolName});
+      symbolsMap->insert({gv, internSymbol(symbolName)});
     }
     cannot_be_symbol:
       ;    
@@ -3,14 +3,25 @@
 
 #include "common.h"
 
+#include <cstdint>
+
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
 
 using namespace llvm;
 
-typedef std::unordered_map<GlobalVariable*, std::string> SymbolsMapTy;
+// symbol names are interned module-wide, so that checking state (guards,
+// call contexts) only holds a 32-bit id of a symbol
+typedef uint32_t SymbolIdTy;
+
+SymbolIdTy internSymbol(const std::string& symbolName);
+std::string getSymbolName(SymbolIdTy symbol); // a copy, interning more symbols may move the names
+size_t symbolsMemoryUsage(); // of the table of interned symbol names
+
+typedef std::unordered_map<GlobalVariable*, SymbolIdTy> SymbolsMapTy;
 
 bool isInstallConstantCall(Value *inst, std::string& symbolName);
+bool isInstallConstantCall(Value *inst, SymbolIdTy& symbol);
 void findSymbols(Module *m, SymbolsMapTy* symbolsMap = NULL);
 
 #endif
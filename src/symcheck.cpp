@@ -34,7 +34,7 @@ int main(int argc, char* argv[])
   
   for(SymbolsMapTy::iterator si = symbolsMap.begin(), se = symbolsMap.end(); si != se; ++si) {
     GlobalVariable *gv = si->first;
-    std::string& name = si->second;
+    std::string name = getSymbolName(si->second);
     
     errs() << "  " << gv->getName() << "  \"" << name << "\"    " << "\n";
   }
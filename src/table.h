@@ -1,165 +1,445 @@
 #ifndef RCHK_TABLE_H
 #define RCHK_TABLE_H
 
-#include <unordered_set>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <utility>
 #include <vector>
 
+// chunked storage for table members
+//
+// members are never moved, so their addresses are stable until clear();
+// chunks grow geometrically so that small tables stay small
+
+template <class Member> class ArenaTy {
+
+  static const size_t FIRST_CHUNK = 16;
+  static const size_t MAX_CHUNK = 4096;
+
+  struct ChunkTy {
+    Member* data;
+    size_t capacity;
+  };
+
+  std::vector<ChunkTy> chunks;
+  size_t used; // members in the last chunk
+  size_t allocated; // bytes
+
+  public:
+    ArenaTy(): chunks(), used(0), allocated(0) {};
+    ArenaTy(const ArenaTy&) = delete;
+    ArenaTy& operator=(const ArenaTy&) = delete;
+    ~ArenaTy() { clear(); }
+
+    template <class... Args> Member* create(Args&&... args) {
+      if (chunks.empty() || used == chunks.back().capacity) {
+        size_t capacity = chunks.empty() ? FIRST_CHUNK : std::min(chunks.back().capacity * 2, (size_t) MAX_CHUNK);
+        chunks.push_back({ static_cast<Member*>(::operator new(capacity * sizeof(Member))), capacity });
+        allocated += capacity * sizeof(Member);
+        used = 0;
+      }
+      Member* m = new (chunks.back().data + used) Member(std::forward<Args>(args)...);
+      used++;
+      return m;
+    }
+
+    void clear() {
+      for (size_t c = 0; c < chunks.size(); c++) {
+        ChunkTy& chunk = chunks[c];
+        size_t n = (c + 1 == chunks.size()) ? used : chunk.capacity;
+        for (size_t i = 0; i < n; i++) {
+          chunk.data[i].~Member();
+        }
+        ::operator delete(chunk.data);
+      }
+      chunks.clear();
+      used = 0;
+      allocated = 0;
+    }
+
+    size_t memoryUsage() const {
+      return allocated + chunks.capacity() * sizeof(ChunkTy);
+    }
+};
+
+// open-addressing (linear probing) slots holding entry numbers
+//
+// the entries themselves are kept by the table, which also provides the
+// hash of an entry when growing; entries are never removed individually
+
+class OpenSlotsTy {
+
+  std::vector<unsigned> slots; // EMPTY or entry number, size is a power of two
+  size_t nentries;
+
+  template <class HashOf> void grow(HashOf hashOf) { // doubles the slots
+    std::vector<unsigned> old;
+    old.swap(slots);
+    slots.assign(old.empty() ? 16 : old.size() * 2, (unsigned) EMPTY);
+    size_t mask = slots.size() - 1;
+    for (unsigned e : old) {
+      if (e == EMPTY) {
+        continue;
+      }
+      size_t pos = hashOf(e) & mask;
+      while (slots[pos] != EMPTY) {
+        pos = (pos + 1) & mask;
+      }
+      slots[pos] = e;
+    }
+  }
+
+  public:
+    static const unsigned EMPTY = UINT_MAX;
+
+    OpenSlotsTy(): slots(), nentries(0) {};
+
+    // spread hash bits, so that pointers (aligned) and small integers probe well
+    static size_t spread(size_t hash) {
+      uint64_t h = (uint64_t) hash * 0x9e3779b97f4a7c15ULL;
+      return (size_t) (h ^ (h >> 32));
+    }
+
+    // position of the slot with a matching entry, or of the empty slot where it would go
+    template <class Matches> size_t probe(size_t hash, Matches matches) const {
+      size_t mask = slots.size() - 1;
+      for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+        unsigned e = slots[pos];
+        if (e == EMPTY || matches(e)) {
+          return pos;
+        }
+      }
+    }
+
+    unsigned at(size_t pos) const {
+      return slots[pos];
+    }
+
+    // position for inserting an entry, from probeEntry (a probe of these slots
+    //   for the entry); the slots only grow when the entry is missing, so
+    //   looking up an existing entry never allocates
+    template <class ProbeEntry, class HashOf> size_t probeForInsert(ProbeEntry probeEntry, HashOf hashOf) {
+      if (!slots.empty()) {
+        size_t pos = probeEntry();
+        if (slots[pos] != EMPTY || (nentries + 1) * 4 <= slots.size() * 3) {
+          return pos;
+        }
+      }
+      grow(hashOf);
+      return probeEntry();
+    }
+
+    void insert(size_t pos, unsigned entry) {
+      slots[pos] = entry;
+      nentries++;
+    }
+
+    bool empty() const {
+      return nentries == 0;
+    }
+
+    void clear() {
+      slots.clear();
+      nentries = 0;
+    }
+
+    size_t memoryUsage() const {
+      return slots.capacity() * sizeof(unsigned);
+    }
+};
+
+// the interning tables also support heterogeneous lookup via find(key) and
+// internKey(key): Hash and KeyEqual have to accept the key type, and Member
+// has to be constructible from it, but no Member is constructed just to probe
+
 template <
   class Member,
   class Hash = std::hash<Member>,
-  class KeyEqual = std::equal_to<Member>,
-  class Allocator = std::allocator<Member>
-  
+  class KeyEqual = std::equal_to<Member>
+
 > class InterningTable {
 
-  typedef std::unordered_set<Member, Hash, KeyEqual, Allocator> Table;
-  Table table;
-  
+  ArenaTy<Member> arena;
+  std::vector<const Member*> members; // entry number -> member
+  std::vector<size_t> hashes; // entry number -> spread hash
+  OpenSlotsTy slots;
+
+  template <class Key> size_t probe(const Key& key, size_t h) const {
+    return slots.probe(h, [&](unsigned e) { return hashes[e] == h && KeyEqual()(*members[e], key); });
+  }
+
+  template <class Key> const Member* insert(const Key& key, size_t h) {
+    size_t pos = slots.probeForInsert([&]() { return probe(key, h); }, [&](unsigned e) { return hashes[e]; });
+    unsigned e = slots.at(pos);
+    if (e != OpenSlotsTy::EMPTY) {
+      return members[e];
+    }
+    const Member* m = arena.create(key);
+    slots.insert(pos, members.size());
+    members.push_back(m);
+    hashes.push_back(h);
+    return m;
+  }
+
   public:
     const Member* intern(const Member& m) {
-      auto minsert = table.insert(m);
-      return &*minsert.first;
+      return insert(m, OpenSlotsTy::spread(Hash()(m)));
     }
-    
+
     const Member* intern(const Member *m) {
       if (!m) {
         return NULL;
       }
       return intern(*m);
     }
-    
+
+    template <class Key> const Member* internKey(const Key& key) {
+      return insert(key, OpenSlotsTy::spread(Hash()(key)));
+    }
+
+    template <class Key> const Member* find(const Key& key) const { // does not add
+      if (slots.empty()) {
+        return NULL;
+      }
+      unsigned e = slots.at(probe(key, OpenSlotsTy::spread(Hash()(key))));
+      return (e == OpenSlotsTy::EMPTY) ? NULL : members[e];
+    }
+
     void clear() {
-      table.clear();
+      slots.clear();
+      members.clear();
+      hashes.clear();
+      arena.clear();
+    }
+
+    size_t size() const {
+      return members.size();
+    }
+
+    size_t memoryUsage() const {
+      return arena.memoryUsage() + slots.memoryUsage() + members.capacity() * sizeof(const Member*) +
+        hashes.capacity() * sizeof(size_t);
     }
 };
 
+// like InterningTable, but also numbers the members (in Member::idx)
+
 template <
   class Member,
   class Hash = std::hash<Member>,
-  class KeyEqual = std::equal_to<Member>,
-  class Allocator = std::allocator<Member>
-  
+  class KeyEqual = std::equal_to<Member>
+
 > class IndexedInterningTable {
 
-  typedef std::unordered_set<Member, Hash, KeyEqual, Allocator> Table;
   typedef std::vector<const Member*> Index;
 
-  Table table;
-  Index index;
-  
+  ArenaTy<Member> arena;
+  Index index; // idx -> member
+  std::vector<size_t> hashes; // idx -> spread hash
+  OpenSlotsTy slots;
+
+  template <class Key> size_t probe(const Key& key, size_t h) const {
+    return slots.probe(h, [&](unsigned e) { return hashes[e] == h && KeyEqual()(*index[e], key); });
+  }
+
+  template <class Key> const Member* insert(const Key& key, size_t h) {
+    size_t pos = slots.probeForInsert([&]() { return probe(key, h); }, [&](unsigned e) { return hashes[e]; });
+    unsigned e = slots.at(pos);
+    if (e != OpenSlotsTy::EMPTY) {
+      return index[e];
+    }
+    Member* m = arena.create(key);
+    m->idx = index.size();
+    slots.insert(pos, m->idx);
+    index.push_back(m);
+    hashes.push_back(h);
+    return m;
+  }
+
   public:
     const Member* intern(const Member& m) {
-      auto msearch = table.find(m);
-      if (msearch != table.end()) {
-        return &*msearch;
-      }
-      
-      Member n = m;
-      n.idx = index.size();
-      const Member *intr = &*table.insert(n).first;
-      index.push_back(intr);
-      return intr;
-    }
-    
+      return insert(m, OpenSlotsTy::spread(Hash()(m)));
+    }
+
     const Member* intern(const Member *m) {
       if (!m) {
         return NULL;
       }
       return intern(*m);
     }
-    
-    const Member* at(unsigned idx) {
+
+    template <class Key> const Member* internKey(const Key& key) {
+      return insert(key, OpenSlotsTy::spread(Hash()(key)));
+    }
+
+    template <class Key> const Member* find(const Key& key) const { // does not add
+      if (slots.empty()) {
+        return NULL;
+      }
+      unsigned e = slots.at(probe(key, OpenSlotsTy::spread(Hash()(key))));
+      return (e == OpenSlotsTy::EMPTY) ? NULL : index[e];
+    }
+
+    const Member* at(unsigned idx) const {
       return index.at(idx);
     }
-    
+
     void clear() {
-      table.clear();
+      slots.clear();
       index.clear();
+      hashes.clear();
+      arena.clear();
     }
-    
+
     const Index* getIndex() const {
       return &index;
     }
+
+    size_t memoryUsage() const {
+      return arena.memoryUsage() + slots.memoryUsage() + index.capacity() * sizeof(const Member*) +
+        hashes.capacity() * sizeof(size_t);
+    }
 };
 
+// numbering of pointers, the index is the only copy of the keys
+
 template <class Member> class IndexedTable {
 
   public:
     typedef std::vector<Member*> Index;
 
   private:
-    typedef std::unordered_map<Member*, unsigned> Table;
-    Table table;
-    Index index;
-  
+    Index index; // idx -> member
+    OpenSlotsTy slots;
+
+    static size_t hashOf(const Member* m) {
+      return OpenSlotsTy::spread((size_t) m);
+    }
+
+    size_t probe(const Member* m) const {
+      return slots.probe(hashOf(m), [&](unsigned e) { return index[e] == m; });
+    }
+
   public:
     unsigned indexOf(Member* m) {
-      auto msearch = table.find(m);
-      if (msearch != table.end()) {
-        return msearch->second;
+      size_t pos = slots.probeForInsert([&]() { return probe(m); }, [&](unsigned e) { return hashOf(index[e]); });
+      unsigned e = slots.at(pos);
+      if (e != OpenSlotsTy::EMPTY) {
+        return e;
       }
       unsigned idx = index.size();
       index.push_back(m);
-      table.insert({m, idx});
+      slots.insert(pos, idx);
       return idx;
     }
-    
-    Member* at(unsigned idx) {
+
+    bool find(const Member* m, unsigned& idx) const { // does not add m
+      if (slots.empty()) {
+        return false;
+      }
+      unsigned e = slots.at(probe(m));
+      if (e == OpenSlotsTy::EMPTY) {
+        return false;
+      }
+      idx = e;
+      return true;
+    }
+
+    Member* at(unsigned idx) const {
       return index.at(idx);
     }
-    
+
     void clear() {
-      table.clear();
+      slots.clear();
       index.clear();
     }
-    
+
     const Index& getIndex() const {
       return index;
     }
-    
-    size_t size() {
+
+    size_t size() const {
       return index.size();
     }
+
+    size_t memoryUsage() const {
+      return slots.memoryUsage() + index.capacity() * sizeof(Member*);
+    }
 };
 
-template <class Member> class IndexedCopyingTable {
+// numbering of values, the index is the only copy of the keys
+
+template <
+  class Member,
+  class Hash = std::hash<Member>,
+  class KeyEqual = std::equal_to<Member>
+
+> class IndexedCopyingTable {
 
   public:
     typedef std::vector<Member> Index;
 
   private:
-    typedef std::unordered_map<Member, unsigned> Table;
-    Table table;
-    Index index;
-  
+    Index index; // idx -> member
+    std::vector<size_t> hashes; // idx -> spread hash
+    OpenSlotsTy slots;
+
+    template <class Key> size_t probe(const Key& key, size_t h) const {
+      return slots.probe(h, [&](unsigned e) { return hashes[e] == h && KeyEqual()(index[e], key); });
+    }
+
   public:
-    unsigned indexOf(Member m) {
-      auto msearch = table.find(m);
-      if (msearch != table.end()) {
-        return msearch->second;
+    template <class Key> unsigned indexOf(const Key& key) {
+      size_t h = OpenSlotsTy::spread(Hash()(key));
+      size_t pos = slots.probeForInsert([&]() { return probe(key, h); }, [&](unsigned e) { return hashes[e]; });
+      unsigned e = slots.at(pos);
+      if (e != OpenSlotsTy::EMPTY) {
+        return e;
       }
       unsigned idx = index.size();
-      index.push_back(m);
-      table.insert({m, idx});
+      index.emplace_back(key);
+      hashes.push_back(h);
+      slots.insert(pos, idx);
       return idx;
     }
-    
-    Member at(unsigned idx) {
+
+    template <class Key> bool find(const Key& key, unsigned& idx) const { // does not add
+      if (slots.empty()) {
+        return false;
+      }
+      unsigned e = slots.at(probe(key, OpenSlotsTy::spread(Hash()(key))));
+      if (e == OpenSlotsTy::EMPTY) {
+        return false;
+      }
+      idx = e;
+      return true;
+    }
+
+    const Member& at(unsigned idx) const {
       return index.at(idx);
     }
-    
+
     void clear() {
-      table.clear();
+      slots.clear();
       index.clear();
+      hashes.clear();
     }
-    
+
     const Index& getIndex() const {
       return index;
     }
-    
-    size_t size() {
+
+    size_t size() const {
       return index.size();
     }
+
+    size_t memoryUsage() const {
+      return slots.memoryUsage() + index.capacity() * sizeof(Member) + hashes.capacity() * sizeof(size_t);
+    }
 };
 
 #endif
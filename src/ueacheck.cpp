@@ -24,6 +24,7 @@
 
 #include "allocators.h"
 #include "cgclosure.h"
+#include "prefilter.h"
 
 using namespace llvm;
 
@@ -208,6 +209,8 @@ int main(int argc, char* argv[])
   FunctionsSetTy possibleAllocators;
   findPossibleAllocators(m, possibleAllocators); // FIXME: use context-sensitive (more precise) allocator detection
 
+  GlobalsTy gl(m);
+
   DominatorTreeWrapperPass dtPass;
 
   for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
@@ -216,7 +219,7 @@ int main(int argc, char* argv[])
     myassert (fisearch != functionsMap.end());
     FunctionInfo& finfo = fisearch->second;
 
-    if (finfo.function->empty()) {
+    if (finfo.function->empty() || isTriviallyCleanForArguments(functionTraits(*FI, gl, possibleAllocators, NULL))) {
       continue;
     }
 
@@ -0,0 +1,36 @@
+
+#include "vartable.h"
+#include "balance.h"
+#include "freshvars.h"
+
+#include <llvm/IR/InstIterator.h>
+
+using namespace llvm;
+
+void VarTableTy::reset(Function *f, const GlobalsTy& g) {
+
+  index.clear();
+  flags.clear();
+
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    AllocaInst *var = dyn_cast<AllocaInst>(&*ii);
+    if (!var) {
+      continue;
+    }
+    unsigned vflags = 0;
+    if (::isSEXP(var)) {
+      vflags |= VF_SEXP;
+      if (isVarCheckedFresh(var)) {
+        vflags |= VF_CHECKED_FRESH;
+      }
+    }
+    if (isProtectionCounterVariable(var, g.unprotectFunction)) {
+      vflags |= VF_COUNTER;
+    }
+    if (isProtectionStackTopSaveVariable(var, g.ppStackTopVariable)) {
+      vflags |= VF_SAVE;
+    }
+    index.indexOf(var);
+    flags.push_back(vflags);
+  }
+}
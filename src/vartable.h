@@ -0,0 +1,70 @@
+#ifndef RCHK_VARTABLE_H
+#define RCHK_VARTABLE_H
+
+#include "common.h"
+#include "table.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Function.h>
+
+using namespace llvm;
+
+// properties of the local variables of a function
+//   they depend only on the code of the function, so they are computed
+//   once before checking the function, and then the handlers only look them
+//   up (a single probe of the variable index per query)
+
+enum VarFlag {
+  VF_SEXP = 1 << 0,		// of type SEXP
+  VF_INT_GUARD = 1 << 1,	// integer guard (set by IntGuardsChecker::reset)
+  VF_SEXP_GUARD = 1 << 2,	// SEXP guard (set by SEXPGuardsChecker::reset)
+  VF_COUNTER = 1 << 3,		// protection counter (e.g. nprotect)
+  VF_SAVE = 1 << 4,		// protection stack top save variable
+  VF_CHECKED_FRESH = 1 << 5,	// SEXP variable supported by the fresh variables checker
+  VF_REPORTED = 1 << 6		// already reported as not supported by the fresh variables checker
+};
+
+class VarTableTy {
+
+  IndexedTable<AllocaInst> index; // all local variables of the function
+  std::vector<uint8_t> flags; // by variable index
+
+  public:
+    VarTableTy(): index(), flags() {};
+
+    void reset(Function *f, const GlobalsTy& g); // computes all but the guard flags for f
+
+    unsigned get(AllocaInst* var) const {
+      unsigned idx;
+      return index.find(var, idx) ? flags[idx] : 0;
+    }
+
+    void set(AllocaInst* var, unsigned flag) {
+      unsigned idx;
+      if (index.find(var, idx)) {
+        flags[idx] |= flag;
+      }
+    }
+
+    bool isSEXP(AllocaInst* var) const { return get(var) & VF_SEXP; }
+    bool isIntGuard(AllocaInst* var) const { return get(var) & VF_INT_GUARD; }
+    bool isSEXPGuard(AllocaInst* var) const { return get(var) & VF_SEXP_GUARD; }
+    bool isProtectionCounter(AllocaInst* var) const { return get(var) & VF_COUNTER; }
+    bool isProtectionStackTopSave(AllocaInst* var) const { return get(var) & VF_SAVE; }
+    bool isCheckedFresh(AllocaInst* var) const { return get(var) & VF_CHECKED_FRESH; }
+
+    unsigned count(unsigned flag) const { // number of variables with the flag
+      unsigned n = 0;
+      for(std::vector<uint8_t>::const_iterator fi = flags.begin(), fe = flags.end(); fi != fe; ++fi) {
+        if (*fi & flag) {
+          n++;
+        }
+      }
+      return n;
+    }
+};
+
+#endif